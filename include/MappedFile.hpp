@@ -0,0 +1,31 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <string_view>
+
+// A whole file read only, memory mapped where the platform allows it (and read into memory elsewhere).
+// The text stays valid as long as the MappedFile lives
+class MappedFile {
+private:
+#ifdef __unix__
+	void* map = nullptr;
+	size_t size = 0;
+#else
+	std::string content;
+#endif
+	bool valid = false;
+
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	// False if the file couldn't be opened or isn't a regular file
+	bool isValid() const;
+
+	std::string_view text() const;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include <cstdint>
+#include <span>
+
+// Turns the flat triangle lists tessellators produce into indexed meshes for VertexArrayObject::DrawElementsAs
+namespace MeshOptimization {
+	template<typename VertexType>
+	struct IndexedMesh {
+		std::vector<VertexType> Vertices;
+		std::vector<std::uint32_t> Indices;
+	};
+
+	using EqualFunction = bool(*)(const void*, const void*);
+
+	// Hash over the raw bytes of a vertex, eight at a time
+	std::uint64_t hashBytes(const std::byte* Data, size_t Bytes);
+
+	// Index of the unique vertex for every vertex, unique vertices are numbered in the order they first appear.
+	// Inputs with at least ParallelThreshold vertices are hashed and looked up on Threads threads (0 for one per core),
+	// the result is the same as on one thread
+	std::vector<std::uint32_t> buildIndices(const std::byte* Vertices, size_t Count, size_t Stride, EqualFunction Equal, std::uint32_t& UniqueCount, unsigned Threads = 0);
+
+	constexpr size_t ParallelThreshold = 1 << 16;
+
+	// Vertices are hashed by their bytes and compared with operator==, so vertices only differing in
+	// padding or in the sign of a zero stay separate (which is harmless, they just aren't shared)
+	template<typename VertexType>
+	IndexedMesh<VertexType> deduplicate(std::span<const VertexType> Flat, unsigned Threads = 0) {
+		static_assert(std::is_trivially_copyable_v<VertexType>);
+
+		IndexedMesh<VertexType> Mesh;
+		std::uint32_t UniqueCount = 0;
+		Mesh.Indices = buildIndices(
+			reinterpret_cast<const std::byte*>(Flat.data()), Flat.size(), sizeof(VertexType),
+			[](const void* A, const void* B) {
+				return *static_cast<const VertexType*>(A) == *static_cast<const VertexType*>(B);
+			},
+			UniqueCount, Threads
+		);
+
+		Mesh.Vertices.resize(UniqueCount);
+		for (size_t i = 0; i < Flat.size(); ++i) {
+			Mesh.Vertices[Mesh.Indices[i]] = Flat[i];
+		}
+		return Mesh;
+	}
+
+	template<typename VertexType>
+	IndexedMesh<VertexType> deduplicate(const std::vector<VertexType>& Flat, unsigned Threads = 0) {
+		return deduplicate(std::span<const VertexType>(Flat), Threads);
+	}
+
+	// Reorders the triangles of a triangle list so vertices are reused while they are still in the post transform
+	// cache (Forsyth's linear speed algorithm), the triangles themselves keep their winding
+	void optimizeVertexCache(std::span<std::uint32_t> Indices, size_t VertexCount);
+
+	// Renumbers the vertices in the order the indices first use them, so the vertex fetch reads the buffer front to back.
+	// Returns the new index of every old vertex, unused vertices get std::numeric_limits<std::uint32_t>::max()
+	std::vector<std::uint32_t> optimizeVertexFetch(std::span<std::uint32_t> Indices, size_t VertexCount, std::uint32_t& UsedCount);
+
+	template<typename VertexType>
+	void optimizeVertexFetch(IndexedMesh<VertexType>& Mesh) {
+		std::uint32_t UsedCount = 0;
+		const auto Remap = optimizeVertexFetch(Mesh.Indices, Mesh.Vertices.size(), UsedCount);
+
+		std::vector<VertexType> Vertices(UsedCount);
+		for (size_t i = 0; i < Mesh.Vertices.size(); ++i) {
+			if (Remap[i] != std::numeric_limits<std::uint32_t>::max()) {
+				Vertices[Remap[i]] = Mesh.Vertices[i];
+			}
+		}
+		Mesh.Vertices = std::move(Vertices);
+	}
+
+	// Both passes, for triangle lists of static meshes. Overdraw isn't taken into account
+	template<typename VertexType>
+	void optimize(IndexedMesh<VertexType>& Mesh) {
+		optimizeVertexCache(Mesh.Indices, Mesh.Vertices.size());
+		optimizeVertexFetch(Mesh);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+#include <map>
+#include <memory>
+
+// Combines separable programs (Shader::Descriptor::separable) into one pipeline with glUseProgramStages
+class ProgramPipeline {
+private:
+	GLuint PipelineId = 0;
+
+	// Flushed on bind, they have to outlive the pipeline
+	std::vector<const Shader*> Programs;
+
+public:
+	// Every program provides the stages it contains, later programs override earlier ones
+	ProgramPipeline(std::initializer_list<const Shader*> Programs);
+
+	ProgramPipeline(const ProgramPipeline&) = delete;
+	ProgramPipeline(ProgramPipeline&&) = delete;
+	ProgramPipeline& operator=(const ProgramPipeline&) = delete;
+	ProgramPipeline& operator=(ProgramPipeline&&) = delete;
+
+	virtual ~ProgramPipeline();
+
+	// Only has an effect if no program is bound with glUseProgram, sends the staged uniforms of the programs
+	void bind() const;
+	void unbind() const;
+
+	// Whether the pipeline can draw with the current GL state (bound textures, sampler types, ...), so only
+	// meaningful right before a draw. Slow, meant for debugging
+	bool validate() const;
+
+	// The program plain glUniform* calls go to while the pipeline is bound, Shader::apply doesn't need it
+	void setActiveProgram(const Shader& Program) const;
+
+	GLuint GetId() const;
+};
+
+// Pipelines keyed by the program ids of their stages, so every combination is only created once.
+// Programs that got rebuilt (e.g. by ShaderWatcher) have new ids, clear() drops the pipelines of the old ones
+class ProgramPipelineCache {
+private:
+	// Program id per stage, in the order of Shader::ShaderType
+	using Key = std::array<GLuint, 6>;
+
+	std::map<Key, std::unique_ptr<ProgramPipeline>> Pipelines;
+
+public:
+	ProgramPipeline& get(std::initializer_list<const Shader*> Programs);
+
+	void clear();
+
+	size_t size() const;
+};
@@ -1,11 +1,29 @@
 #pragma once
 
 #include "pch.hpp"
+
+#include "Utilities.hpp"
+
+#include <chrono>
 #include <cstddef>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
 #include <variant>
 
+class ShaderArchive;
+class ShaderBinaryCache;
+
+// A uniform named by a literal, the name is hashed at compile time so applying it is a probe
+// of the program's name table instead of hashing the string every call
+template<FixedString Name, typename Data>
+struct Uniform {
+	static constexpr std::string_view name = Name.view();
+	static constexpr std::uint64_t hash = fnv1a(name);
+	using DataType = Data;
+};
+
 class Shader {
 public:
 	//Arguments: Where the Error occured, the msg;
@@ -15,182 +33,504 @@ public:
 		Vertex,
 		Geometry,
 		Fragment,
+		TessControl,
+		TessEvaluation,
+		Compute,
+	};
+
+	// A precompiled SPIR-V module (e.g. from glslangValidator -G), used with GL_ARB_gl_spirv.
+	// Drivers without it compile the glsl fallback instead, the constants are not applied to it
+	struct SpirV {
+		std::vector<std::uint32_t> code;
+		std::string entryPoint = "main";
+		// constant_id -> value, floats as their bit pattern
+		std::vector<std::pair<GLuint, GLuint>> constants;
+		std::variant<std::monostate, std::filesystem::path, std::string> fallback;
 	};
 
-	using ShaderSource = std::variant<std::filesystem::path, std::string>;
+	// A string_view is not copied until the program is compiled, it has to outlive the Shader
+	// (e.g. sources in a memory mapped ShaderArchive)
+	using ShaderSource = std::variant<std::filesystem::path, std::string, std::string_view, SpirV>;
 
 	struct ShaderInfo {
 		ShaderType type;
 		ShaderSource source;
 	};
 
+	struct Descriptor {
+		// specify binaryLocation if you want to cache the compiled porgramm somewhere
+		// if a binary matching the sources and the driver exists there it is loaded instead of compiling
+		std::optional<std::filesystem::path> binaryLocation = std::nullopt;
+
+		// only submit the stages and the link, the status is checked (and errors are reported) once the
+		// program is polled with isReady() or wait() or is used for the first time
+		bool deferred = false;
+
+		// link as separable program (GL_PROGRAM_SEPARABLE), usually with a single stage, to be combined
+		// with other separable programs in a ProgramPipeline instead of linking every combination
+		bool separable = false;
+
+		// A program binary matching the sources and the driver is taken from the archive if it has one
+		const ShaderArchive* archive = nullptr;
+
+		// Like binaryLocation, but in a size limited directory that several processes can share
+		ShaderBinaryCache* binaryCache = nullptr;
+
+		// Names the program in timing dumps and for GL debuggers (glObjectLabel)
+		std::string label;
+	};
+
+	// Where the time to build a program went. With GL_KHR_parallel_shader_compile (or a driver compiling
+	// lazily) the compile work ends up in link, which measures until the link status was known
+	struct Timings {
+		using Duration = std::chrono::nanoseconds;
+		// Reading and scanning files that weren't in ShaderSourceCache yet, files ShaderLibrary::buildAll
+		// preloaded on its threads count as cached
+		Duration read{};
+		// Expanding includes and everything else to get the text of every stage
+		Duration preprocess{};
+		// Submitting every stage, indexed by ShaderType
+		std::array<Duration, 6> compile{};
+		Duration link{};
+		// Looking up and loading a binary, also when none was found
+		Duration binaryLoad{};
+		// glGetProgramBinary and storing the binary
+		Duration binaryRetrieval{};
+		Duration reflection{};
+		bool fromBinary = false;
+
+		Duration total() const;
+	};
+
 private:
-	static const constexpr std::array<GLenum, 3> shaderTypeToGlEnum = {
+	static const constexpr std::array<GLenum, 6> shaderTypeToGlEnum = {
 		GL_VERTEX_SHADER,
 		GL_GEOMETRY_SHADER,
 		GL_FRAGMENT_SHADER,
+		GL_TESS_CONTROL_SHADER,
+		GL_TESS_EVALUATION_SHADER,
+		GL_COMPUTE_SHADER,
 	};
 
-	static const constexpr std::array<std::string_view, 3> shaderTypeToName = {
+	static const constexpr std::array<GLbitfield, 6> shaderTypeToStageBit = {
+		GL_VERTEX_SHADER_BIT,
+		GL_GEOMETRY_SHADER_BIT,
+		GL_FRAGMENT_SHADER_BIT,
+		GL_TESS_CONTROL_SHADER_BIT,
+		GL_TESS_EVALUATION_SHADER_BIT,
+		GL_COMPUTE_SHADER_BIT,
+	};
+
+	static const constexpr std::array<std::string_view, 6> shaderTypeToName = {
 		"Vertex",
 		"Geometry",
 		"Fragment",
+		"TessControl",
+		"TessEvaluation",
+		"Compute",
 	};
 
 private:
-	GLuint shaderId;
+	// mutable because a deferred program is finished lazily, also from const accessors
+	mutable GLuint shaderId;
+
+	// GL_*_SHADER_BIT of every stage in the program
+	GLbitfield stages = 0;
+
+	// glProgramUniform*v matching the type the uniform was declared with, picked once at link time
+	using UniformSetter = void(*)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const void* value);
+
+	static UniformSetter uniformSetter(GLenum type);
 
 	struct UniformInfo {
 		GLint location;
-		size_t lastHash;
+		GLenum type;
+		GLsizei arraySize;
+		UniformSetter setter;
+		// Slot of the last uploaded value in uniformShadow
+		std::uint32_t offset;
+		std::uint32_t size;
+		// Elements of an array uniform the last value covered
+		GLsizei count;
+		bool uploaded;
+		// Staged but not sent yet, the slot is in dirtySlots
+		bool dirty;
+		GLboolean transpose;
+	};
+
+	// Open addressing table from the fnv1a hash of a uniform name to its slot, a power of two large and
+	// at most half full. Only hashes are compared, names colliding in one program are reported through the
+	// ErrorHandler when the program is reflected and resolve to no uniform instead of to the wrong one
+	struct NameEntry {
+		// Slot of a hash shared by several uniform names
+		static constexpr std::uint32_t ambiguous = std::uint32_t(-2);
+
+		std::uint64_t hash;
+		std::uint32_t slot;
+	};
+
+	// The slots are what a UniformHandle points to, the name lookup is only needed to resolve handles
+	mutable std::vector<UniformInfo> uniformInfo;
+	mutable std::vector<NameEntry> uniformNames;
+	// Bytes of the last value uploaded to every active uniform, a redundant apply is a memcmp against it
+	mutable std::vector<std::byte> uniformShadow;
+	// Slots whose shadow holds a staged value GL hasn't seen yet, sent by flush()
+	mutable std::vector<std::uint32_t> dirtySlots;
+
+	// Everything needed to finish a program whose compile and link were only submitted
+	struct Pending {
+		ErrorHandler err;
+		// SPIR-V stages have the module as content
+		std::vector<std::tuple<ShaderType, std::string>> shaderContents;
+		std::vector<bool> spirv;
+		std::vector<GLuint> shaderIds;
+		std::optional<std::filesystem::path> binaryLocation;
+		ShaderBinaryCache* binaryCache = nullptr;
+	};
+
+	mutable std::unique_ptr<Pending> pending;
+
+	static GLuint compile(const std::string& shaderSource, GLenum type);
+	static GLuint compileSpirV(const SpirV& module, GLenum type);
+
+	static bool compileStatus(GLuint id, ShaderType type, const std::string& shaderSource, ErrorHandler err);
+
+	void finish() const;
+
+	// What the program was built from, to build it again after its files changed
+	struct Origin {
+		ErrorHandler err;
+		std::vector<ShaderInfo> shaders;
+		Descriptor desc;
 	};
 
-	std::unordered_map<std::string, UniformInfo> uniformInfo;
+	std::shared_ptr<const Origin> origin;
+
+	void release();
+
+	// Every file the program was built from, including the ones pulled in by #include
+	std::vector<std::filesystem::path> sourceFiles;
+
+	static std::string parse(const std::filesystem::path& filename, ErrorHandler err, std::vector<std::filesystem::path>& dependencies);
+
+	// Hash over all stage sources and the driver identification, a cached binary is only reused if it matches
+	static std::uint64_t binaryKey(const std::vector<std::tuple<ShaderType, std::string>>& shaderContents, bool separable);
+
+	// binaryKey() of the sources the program was built from
+	std::uint64_t programKey = 0;
+
+	std::string label;
+	mutable Timings timing;
+
+	// Changes with every reflection of every program, handles carry it so one resolved before a reload
+	// (or for another program) is rejected instead of pointing at a different uniform
+	mutable std::uint32_t generation = 0;
+
+	// Bindings assigned through bindUniformBlock/bindStorageBlock, kept over replaceWith
+	struct BlockBinding {
+		GLenum interface;
+		std::string name;
+		GLuint binding;
+	};
+	mutable std::vector<BlockBinding> blockBindings;
+
+	void rememberBinding(GLenum interface, std::string_view name, GLuint binding) const;
+
+	bool loadBinary(GLenum binaryFormat, const void* binary, size_t length);
+	bool loadBinary(const std::filesystem::path& binaryLocation, std::uint64_t key);
+
+	void saveBinary(const std::filesystem::path& binaryLocation, std::uint64_t key) const;
 
-	static GLuint compile(const std::string& shaderSource, GLenum type, ErrorHandler err);
+	void reflect() const;
 
-	static std::string parse(const std::filesystem::path& filename, ErrorHandler err);
+public:
+	// Everything the linker reports about the program, queried once when it is finished
+	struct Reflection {
+		struct Uniform {
+			std::string name;
+			GLenum type;
+			GLint arraySize;
+			// -1 for members of uniform blocks, they are set through the buffer
+			GLint location;
+			// Index into uniformBlocks and the byte offset inside the block, -1 in the default block
+			GLint blockIndex;
+			GLint offset;
+		};
+
+		struct Attribute {
+			std::string name;
+			GLenum type;
+			GLint arraySize;
+			GLint location;
+		};
+
+		struct Block {
+			std::string name;
+			GLint binding;
+			GLint dataSize;
+			GLint activeVariables;
+		};
+
+		std::vector<Uniform> uniforms;
+		// Inputs of the first stage, the vertex attributes unless the program is a separable later stage
+		std::vector<Attribute> attributes;
+		// Indexed by the block index
+		std::vector<Block> uniformBlocks;
+		std::vector<Block> storageBlocks;
+	};
+
+private:
+	mutable Reflection reflected;
 
 public:
 
-	// specify binaryLocation if you want to save the compiled porgramm somewhere
+	// The glsl text of a source, files are read through ShaderSourceCache::global() which expands their #include "file" lines.
+	// The files the text was made of are added to dependencies, SPIR-V sources give the text of their fallback
+	static std::string read(const ShaderSource& source, ErrorHandler err, std::vector<std::filesystem::path>* dependencies = nullptr);
+
+	// Empty (and reported through err) if the file can't be read or isn't a SPIR-V module
+	static std::vector<std::uint32_t> readSpirV(const std::filesystem::path& file, ErrorHandler err);
+
+	Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const Descriptor& desc);
+
 	Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const std::optional<std::filesystem::path>& binaryLocation = std::nullopt);
 
 	Shader(const Shader&) = delete;
 	Shader(Shader&&) = delete;
 	Shader& operator=(const Shader&) = delete;
 
+	// Replaces this program with other (deleting the current one), the uniform table is the one of other
 	Shader& operator=(Shader&&);
 
+	// Like operator= for a rebuilt version of this program, block bindings assigned to this one are
+	// assigned to the blocks of the same name in rebuilt
+	void replaceWith(Shader&& rebuilt);
+
 	virtual ~Shader();
 
+	// Non blocking with GL_KHR_parallel_shader_compile, otherwise this waits for the driver
+	bool isReady() const;
+	void wait() const;
+
 	void bind() const;
 	void unbind() const;
 
 	const GLuint& GetId() const;
 
-	GLint uniformLocation(const std::string& name) const;
+	GLbitfield stageBits() const;
+
+	static GLbitfield stageBit(ShaderType type);
+
+	// Hash of the vendor, renderer and version strings, program binaries are only valid for the driver that made them
+	static std::uint64_t driverFingerprint();
+
+	struct Binary {
+		GLenum format;
+		// Identifies sources and driver, what a binary is looked up by
+		std::uint64_t key;
+		std::vector<std::byte> data;
+	};
+
+	// The linked program from glGetProgramBinary, nullopt if it failed or the driver has no binary formats
+	std::optional<Binary> binary() const;
+
+	// Complete once the program is finished
+	const Timings& timings() const;
+
+	// The timings as one json object, durations in microseconds
+	std::string timingsJson() const;
+
+	const std::vector<std::filesystem::path>& dependencies() const;
+	bool dependsOn(const std::filesystem::path& file) const;
+
+	// A new program from the same sources and descriptor, files are read again (through the source cache)
+	std::unique_ptr<Shader> rebuild(bool deferred = true) const;
+
+	const Reflection& reflection() const;
+
+	GLint uniformLocation(std::string_view name) const;
+
+	// Resolved once per program, only valid for the Shader that created it and until it is replaced
+	class UniformHandle {
+		friend Shader;
+		static constexpr std::uint32_t invalid = std::uint32_t(-1);
+		std::uint32_t index = invalid;
+		std::uint32_t generation = 0;
+		constexpr UniformHandle(std::uint32_t index, std::uint32_t generation) : index(index), generation(generation) {}
+	public:
+		constexpr UniformHandle() = default;
+		constexpr bool valid() const { return index != invalid; }
+	};
+
+	UniformHandle uniformHandle(std::string_view name) const;
+
+	// name hashed with fnv1a, what Uniform<...>::hash is
+	UniformHandle uniformHandle(std::uint64_t nameHash) const;
+
+	// Connect a named interface block to a binding point, the buffer bound there is shared by every
+	// program that connects its block to the same point. Returns false if the block isn't active
+	bool bindUniformBlock(std::string_view name, GLuint binding) const;
+	bool bindStorageBlock(std::string_view name, GLuint binding) const;
+
+	// Compute programs only, the program has to be bound
+	void dispatch(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1) const;
+	// Reads the group counts from the buffer bound to GL_DISPATCH_INDIRECT_BUFFER
+	void dispatchIndirect(GLintptr offset = 0) const;
+	void dispatchIndirect(GLuint buffer, GLintptr offset) const;
+
+	// local_size_x/y/z of a compute program
+	std::array<GLint, 3> workGroupSize() const;
+
+	// Makes writes of a dispatch visible to the following reads, e.g. GL_SHADER_STORAGE_BARRIER_BIT
+	// before reading the results in the next dispatch or GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT before drawing from them
+	static void memoryBarrier(GLbitfield barriers = GL_ALL_BARRIER_BITS);
+	static void memoryBarrierByRegion(GLbitfield barriers);
 
 	struct Data1f {
+	    static constexpr GLenum glType = GL_FLOAT;
 	    GLfloat v0;
 	    void apply(GLint location) const;
 	};
 	struct Data2f {
+	    static constexpr GLenum glType = GL_FLOAT_VEC2;
 	    GLfloat v0, v1;
 	    void apply(GLint location) const;
 	};
 	struct Data3f { GLfloat v0, v1, v2;
+	    static constexpr GLenum glType = GL_FLOAT_VEC3;
 	    void apply(GLint location) const;
 	};
 	struct Data4f {
+	    static constexpr GLenum glType = GL_FLOAT_VEC4;
 	    GLfloat v0, v1, v2, v3;
 	    void apply(GLint location) const;
 	};
 	struct Data1i {
+	    static constexpr GLenum glType = GL_INT;
 	    GLint v0;
 	    void apply(GLint location) const;
 	};
 	struct Data2i {
+	    static constexpr GLenum glType = GL_INT_VEC2;
 	    GLint v0, v1;
 	    void apply(GLint location) const;
 	};
 	struct Data3i {
+	    static constexpr GLenum glType = GL_INT_VEC3;
 	    GLint v0, v1, v2;
 	    void apply(GLint location) const;
 	};
 	struct Data4i {
+	    static constexpr GLenum glType = GL_INT_VEC4;
 	    GLint v0, v1, v2, v3;
 	    void apply(GLint location) const;
 	};
 	struct Data1ui {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT;
 	    GLuint v0;
 	    void apply(GLint location) const;
 	};
 	struct Data2ui {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC2;
 	    GLuint v0, v1;
 	    void apply(GLint location) const;
 	};
 	struct Data3ui {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC3;
 	    GLuint v0, v1, v2;
 	    void apply(GLint location) const;
 	};
 	struct Data4ui {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC4;
 	    GLuint v0, v1, v2, v3;
 	    void apply(GLint location) const;
 	};
 	struct Data1fv {
+	    static constexpr GLenum glType = GL_FLOAT;
 			constexpr const static size_t elements = 1;
 	    GLsizei count;
 	    const GLfloat* value;
 	    void apply(GLint location) const;
 	};
 	struct Data2fv {
+	    static constexpr GLenum glType = GL_FLOAT_VEC2;
 			constexpr const static size_t elements = 2;
 	    GLsizei count;
 	    const GLfloat* value;
 	    void apply(GLint location) const;
 	};
 	struct Data3fv {
+	    static constexpr GLenum glType = GL_FLOAT_VEC3;
 			constexpr const static size_t elements = 3;
 	    GLsizei count;
 	    const GLfloat* value;
 	    void apply(GLint location) const;
 	};
 	struct Data4fv {
+	    static constexpr GLenum glType = GL_FLOAT_VEC4;
 			constexpr const static size_t elements = 4;
 	    GLsizei count;
 	    const GLfloat* value;
 	    void apply(GLint location) const;
 	};
 	struct Data1iv {
+	    static constexpr GLenum glType = GL_INT;
 			constexpr const static size_t elements = 1;
 	    GLsizei count;
 	    const GLint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data2iv {
+	    static constexpr GLenum glType = GL_INT_VEC2;
 			constexpr const static size_t elements = 2;
 	    GLsizei count;
 	    const GLint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data3iv {
+	    static constexpr GLenum glType = GL_INT_VEC3;
 			constexpr const static size_t elements = 3;
 	    GLsizei count;
 	    const GLint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data4iv {
+	    static constexpr GLenum glType = GL_INT_VEC4;
 			constexpr const static size_t elements = 4;
 	    GLsizei count;
 	    const GLint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data1uiv {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT;
 			constexpr const static size_t elements = 1;
 	    GLsizei count;
 	    const GLuint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data2uiv {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC2;
 			constexpr const static size_t elements = 2;
 	    GLsizei count;
 	    const GLuint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data3uiv {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC3;
 			constexpr const static size_t elements = 3;
 	    GLsizei count;
 	    const GLuint* value;
 	    void apply(GLint location) const;
 	};
 	struct Data4uiv {
+	    static constexpr GLenum glType = GL_UNSIGNED_INT_VEC4;
 			constexpr const static size_t elements = 4;
 	    GLsizei count;
 	    const GLuint* value;
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix2fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT2;
 			constexpr const static size_t elements = 2 * 2;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -198,6 +538,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix3fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT3;
 			constexpr const static size_t elements = 3 * 3;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -205,6 +546,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix4fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT4;
 			constexpr const static size_t elements = 4 * 4;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -212,6 +554,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix2x3fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT2x3;
 			constexpr const static size_t elements = 2 * 3;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -219,6 +562,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix3x2fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT3x2;
 			constexpr const static size_t elements = 3 * 2;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -226,6 +570,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix2x4fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT2x4;
 			constexpr const static size_t elements = 2 * 4;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -233,6 +578,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix4x2fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT4x2;
 			constexpr const static size_t elements = 4 * 2;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -240,6 +586,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix3x4fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT3x4;
 			constexpr const static size_t elements = 3 * 4;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -247,6 +594,7 @@ public:
 	    void apply(GLint location) const;
 	};
 	struct DataMatrix4x3fv {
+	    static constexpr GLenum glType = GL_FLOAT_MAT4x3;
 			constexpr const static size_t elements = 4 * 3;
 	    GLsizei count;
 	    GLboolean transpose;
@@ -265,5 +613,74 @@ public:
         DataMatrix4x2fv, DataMatrix3x4fv, DataMatrix4x3fv
         >;
 
-		void apply(const std::string& name, const UniformData& data);
+private:
+	// Shared by every typed apply and stage, bytes is what the data points to (all array elements)
+	void upload(UniformHandle handle, GLenum dataType, const void* data, size_t bytes, GLboolean transpose, bool deferred);
+
+	template<typename T>
+		requires requires { T::glType; }
+	void upload(UniformHandle handle, const T& data, bool deferred) {
+		if constexpr (requires { T::elements; }) {
+			GLboolean transpose = GL_FALSE;
+			if constexpr (requires { data.transpose; }) {
+				transpose = data.transpose;
+			}
+			upload(handle, T::glType, data.value, sizeof(*data.value) * T::elements * std::max<GLsizei>(data.count, 0), transpose, deferred);
+		}
+		else {
+			upload(handle, T::glType, &data, sizeof(T), GL_FALSE, deferred);
+		}
+	}
+
+	void send(const UniformInfo& info) const;
+
+public:
+	// Typed upload with glProgramUniform*, the program doesn't have to be bound. Goes straight to the setter
+	// picked at link time. Debug builds reject data that doesn't match the declared type
+	// (bools take ints or uints, samplers and images take Data1i)
+	template<typename T>
+		requires requires { T::glType; }
+	void apply(UniformHandle handle, const T& data) {
+		upload(handle, data, false);
+	}
+
+	// Convenience, resolves the handle on every call
+	template<typename T>
+		requires requires { T::glType; }
+	void apply(std::string_view name, const T& data) {
+		apply(uniformHandle(name), data);
+	}
+
+		void apply(UniformHandle handle, const UniformData& data);
+
+		void apply(std::string_view name, const UniformData& data);
+
+	// Like apply, but only the shadow copy is updated. Values that changed are sent by the next flush(),
+	// which bind() does, so uniforms of many programs can be prepared without binding any of them
+	template<typename T>
+		requires requires { T::glType; }
+	void stage(UniformHandle handle, const T& data) {
+		upload(handle, data, true);
+	}
+
+	struct UniformUpdate {
+		UniformHandle handle;
+		UniformData data;
+	};
+
+	void stage(std::span<const UniformUpdate> updates);
+
+	template<FixedString Name, typename T>
+	void apply(Uniform<Name, T>, const std::type_identity_t<T>& data) {
+		apply(uniformHandle(Uniform<Name, T>::hash), data);
+	}
+
+	template<FixedString Name, typename T>
+	void stage(Uniform<Name, T>, const std::type_identity_t<T>& data) {
+		stage(uniformHandle(Uniform<Name, T>::hash), data);
+	}
+
+	// Sends every staged value that differs from what GL has, programs used through a ProgramPipeline
+	// are flushed by ProgramPipeline::bind()
+	void flush() const;
 };
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "MappedFile.hpp"
+#include "Shader.hpp"
+
+#include <map>
+#include <memory>
+#include <span>
+
+// Programs packed into one file for shipping. The file is memory mapped and the sources are handed
+// to Shader as string_views into the mapping, so opening it is one file instead of one per source.
+// Sources are stored preprocessed (includes expanded) and only once, however many programs use them.
+// Program binaries are optional and can be stored for any number of drivers, a program built with
+// Descriptor::archive set loads the one matching its sources and the current driver instead of compiling.
+//
+// Layout, native endianness and offsets from the start of the file:
+//   Header, SourceEntry[sources], ProgramEntry[programs], BinaryEntry[binaries], then the names,
+//   source texts and binaries the entries point to
+class ShaderArchive {
+private:
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t sources;
+		std::uint32_t programs;
+		std::uint32_t binaries;
+	};
+
+	struct SourceEntry {
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	struct ProgramEntry {
+		std::uint64_t nameOffset;
+		std::uint32_t nameSize;
+		std::uint32_t separable;
+		std::uint32_t stageCount;
+		// Shader::ShaderType and index of the source
+		std::uint32_t stages[6][2];
+	};
+
+	struct BinaryEntry {
+		// Shader::Binary::key, contains the driver
+		std::uint64_t key;
+		// Shader::driverFingerprint() of the driver that made it
+		std::uint64_t fingerprint;
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::uint32_t format;
+		std::uint32_t reserved;
+	};
+
+	static constexpr std::array<char, 8> magic = {'M', 'Y', 'G', 'L', 'S', 'H', 'A', 'R'};
+	static constexpr std::uint32_t version = 1;
+
+	struct StoredProgram {
+		bool separable;
+		std::vector<std::pair<Shader::ShaderType, std::uint32_t>> stages;
+	};
+
+	struct StoredBinary {
+		std::uint64_t key;
+		std::uint64_t fingerprint;
+		GLenum format;
+		std::span<const std::byte> data;
+	};
+
+	std::unique_ptr<MappedFile> file;
+	std::vector<std::string_view> sources;
+	std::map<std::string_view, StoredProgram, std::less<>> programs;
+	std::vector<StoredBinary> binaries;
+
+public:
+	struct Program {
+		// Views into the archive
+		std::vector<Shader::ShaderInfo> shaders;
+		// separable as stored and archive pointing to this archive
+		Shader::Descriptor desc;
+	};
+
+	// An archive that can't be read is reported through err, it is empty and not open
+	ShaderArchive(const std::filesystem::path& location, Shader::ErrorHandler err);
+
+	ShaderArchive(const ShaderArchive&) = delete;
+	ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+	bool isOpen() const;
+
+	std::vector<std::string_view> names() const;
+
+	// To construct a Shader with, valid as long as the archive
+	std::optional<Program> find(std::string_view name) const;
+
+	// Empty if there is no binary for the key
+	std::span<const std::byte> binary(std::uint64_t key, GLenum& format) const;
+
+	class Writer {
+	private:
+		std::vector<std::string> sources;
+		// fnv1a of the text -> indices of sources with that hash
+		std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> sourceIndex;
+
+		struct ProgramData {
+			std::string name;
+			StoredProgram program;
+		};
+		std::vector<ProgramData> programs;
+
+		struct BinaryData {
+			std::uint64_t fingerprint;
+			Shader::Binary binary;
+		};
+		std::vector<BinaryData> binaries;
+
+		std::uint32_t addSource(std::string text);
+
+	public:
+		Writer() = default;
+
+		// Starts with the content of archive, e.g. to add the binaries for this driver to a shipped archive
+		explicit Writer(const ShaderArchive& archive);
+
+		// Reads and preprocesses the sources now. A program with the same name is replaced
+		void add(const std::string& name, const std::vector<Shader::ShaderInfo>& shaders, Shader::ErrorHandler err, bool separable = false);
+
+		// The binary of a program built from the same sources on the current driver, replaces an older one for the same key
+		bool addBinary(const Shader& program);
+
+		// Written to a temporary file next to location first, so a reader never sees half an archive
+		bool write(const std::filesystem::path& location, Shader::ErrorHandler err) const;
+	};
+};
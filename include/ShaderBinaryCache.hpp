@@ -0,0 +1,53 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+// A directory of program binaries that several processes can share. Files are named after the
+// binary key (sources and driver), so a name always means the same content. They are written to a
+// temporary file and renamed into place, a reader sees either nothing or a whole file, and carry a
+// checksum that is verified on load. Whenever the directory grows past the budget the least recently
+// used binaries are deleted, loading a binary counts as use.
+class ShaderBinaryCache {
+private:
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t format;
+		std::uint64_t key;
+		std::uint64_t size;
+		// fnv1a of the binary
+		std::uint64_t checksum;
+	};
+
+	static constexpr std::array<char, 8> magic = {'M', 'Y', 'G', 'L', 'P', 'B', 'I', 'N'};
+	static constexpr std::uint32_t version = 1;
+
+	std::filesystem::path directory;
+	std::uintmax_t budget;
+	// Bytes in the directory at the last scan plus what was stored since, other processes' files are
+	// only seen by the next scan
+	std::uintmax_t knownSize = 0;
+
+	std::filesystem::path location(std::uint64_t key) const;
+
+public:
+	// budget in bytes over all binaries in the directory, the directory is created if needed
+	ShaderBinaryCache(std::filesystem::path directory, std::uintmax_t budget = 64 * 1024 * 1024);
+
+	// nullopt if there is none, it is damaged (a damaged file is deleted) or it belongs to another key or version
+	std::optional<Shader::Binary> load(std::uint64_t key) const;
+
+	// Replaces a binary with the same key, then evicts down to the budget if the directory may have outgrown it
+	bool store(const Shader::Binary& binary);
+
+	// Deletes the least recently used binaries until the rest fits into the budget, and temporary
+	// files left behind by writers that died
+	void evict();
+
+	// Bytes of all binaries currently in the directory
+	std::uintmax_t size() const;
+
+	const std::filesystem::path& GetDirectory() const;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+#include <map>
+#include <memory>
+#include <span>
+
+// Owns programs by name and builds many of them at once: all files are read on a thread pool first,
+// then every compile and link is submitted to the driver before the status of any of them is checked,
+// so the reads and the compiles (with GL_KHR_parallel_shader_compile) overlap instead of lining up
+class ShaderLibrary {
+public:
+	struct ProgramDesc {
+		std::string name;
+		std::vector<Shader::ShaderInfo> shaders;
+		// deferred programs are left pending, all others are finished when buildAll returns
+		Shader::Descriptor desc = {};
+	};
+
+private:
+	Shader::ErrorHandler err;
+	std::map<std::string, std::unique_ptr<Shader>, std::less<>> programs;
+
+public:
+	explicit ShaderLibrary(Shader::ErrorHandler err);
+
+	// Call on the thread owning the GL context. A program with the name of an existing one replaces it.
+	// threads is the number of threads reading files, 0 for one per core
+	void buildAll(std::span<const ProgramDesc> descs, unsigned threads = 0);
+
+	// nullptr if there is no program with that name
+	Shader* get(std::string_view name) const;
+
+	size_t size() const;
+
+	// JSON array with Shader::timingsJson of every program, programs without a label are labeled with their name
+	std::string timingsJson() const;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <span>
+
+// Shader files read from disk and split at their #include "file" lines, shared by all programs so a
+// common header is only read and scanned once. load() may be called from any thread, the rest of the
+// library only uses the cache from the GL thread
+class ShaderSourceCache {
+public:
+	struct File {
+		// Text between the includes, always one more segment than includes
+		std::vector<std::string> segments;
+		// Resolved relative to the including file
+		std::vector<std::filesystem::path> includes;
+		// Line of every #include, to continue the numbering after the included text
+		std::vector<size_t> includeLines;
+	};
+
+private:
+	std::mutex mutex;
+	std::unordered_map<std::string, std::shared_ptr<const File>> files;
+
+	void append(const std::filesystem::path& file, Shader::ErrorHandler err, std::vector<std::filesystem::path>& dependencies, std::string& out);
+
+public:
+	static ShaderSourceCache& global();
+
+	static std::filesystem::path normalize(const std::filesystem::path& file);
+
+	// Time the calling thread spent reading and scanning files in load() so far
+	static std::chrono::nanoseconds readTime();
+
+	// nullptr if the file can't be opened, failed loads aren't cached
+	std::shared_ptr<const File> load(const std::filesystem::path& file, Shader::ErrorHandler err);
+
+	// Loads files and everything they include on up to threads threads (0 for one per core), every file
+	// once even if it is listed or included several times. Errors aren't reported here but by the
+	// resolve() that needs the file, on the calling thread
+	void preload(std::span<const std::filesystem::path> files, unsigned threads = 0);
+
+	// Text of file with all includes expanded, every file is included at most once (implicit include guard).
+	// dependencies is set to file and everything it includes, in the order they were first included.
+	// #line directives use the index into dependencies as source string number, so "2:14(3)" in a
+	// compiler message means line 14 of dependencies[2]
+	std::string resolve(const std::filesystem::path& file, Shader::ErrorHandler err, std::vector<std::filesystem::path>& dependencies);
+
+	// Drop a file that changed on disk, the next load reads it again
+	void invalidate(const std::filesystem::path& file);
+	void clear();
+};
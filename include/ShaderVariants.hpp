@@ -0,0 +1,47 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+#include <map>
+#include <memory>
+
+// Permutations of one program that only differ in their #defines, compiled the first time they are requested
+class ShaderVariants {
+public:
+	// Name -> value, an empty value gives a plain "#define Name"
+	using Defines = std::map<std::string, std::string>;
+
+private:
+	Shader::ErrorHandler err;
+	std::vector<Shader::ShaderInfo> shaders;
+	Shader::Descriptor desc;
+
+	// The base sources are read once, on the first request
+	std::vector<Shader::ShaderInfo> sources;
+	std::uint64_t sourceHash = 0;
+	bool sourcesRead = false;
+
+	std::unordered_map<std::uint64_t, std::unique_ptr<Shader>> variants;
+
+	void readSources();
+
+public:
+	// binaryLocation in desc is used as a pattern, every variant caches its binary under its own key
+	ShaderVariants(Shader::ErrorHandler err, std::vector<Shader::ShaderInfo> shaders, const Shader::Descriptor& desc = {});
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	Shader& get(const Defines& defines = {});
+
+	// 64 bit key of a variant made from the hash of the base sources and the define set
+	std::uint64_t key(const Defines& defines);
+
+	size_t size() const;
+
+	// Inserts the defines after the #version line (or at the start if there is none),
+	// followed by a #line so compiler messages still refer to the original lines
+	static std::string injectDefines(std::string_view source, const Defines& defines);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Shader.hpp"
+
+#include <memory>
+
+// Rebuilds programs whose files (including everything they #include) changed on disk.
+// On Linux changes are picked up with inotify, elsewhere changed() has to be called by hand.
+// The new program is compiled deferred next to the old one, which keeps being used until the new one
+// linked successfully and is moved into it. A program that fails to build is reported through its
+// ErrorHandler and the old one stays.
+class ShaderWatcher {
+private:
+	int inotifyFd = -1;
+	// Watch descriptor -> directory, directories are watched because editors often replace files
+	std::unordered_map<int, std::filesystem::path> directories;
+
+	std::vector<Shader*> shaders;
+
+	struct Rebuild {
+		Shader* target;
+		std::unique_ptr<Shader> shader;
+	};
+	std::vector<Rebuild> rebuilding;
+
+	void watchFiles(const Shader& shader);
+
+public:
+	ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	~ShaderWatcher();
+
+	// The shader has to be unwatched before it is destroyed
+	void watch(Shader& shader);
+	void unwatch(Shader& shader);
+
+	// Starts rebuilding every watched program that depends on file
+	void changed(const std::filesystem::path& file);
+
+	// Call regularly on the thread owning the GL context. Returns the programs that were replaced
+	// during this call, UniformHandles of those have to be resolved again (old ones are rejected) and their
+	// uniforms set again, block bindings are kept
+	std::vector<Shader*> poll();
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Utilities.hpp"
+
+#include <cstdint>
+
+// Glsl types with the C++ size the std140/std430 rules expect, they carry no alignment of their own
+// so a block struct has to place them where glsl does (the layout check below enforces that)
+namespace Glsl {
+	template<typename Scalar, size_t N>
+	struct Vec {
+		Scalar data[N];
+		bool operator ==(const Vec& Other) const = default;
+	};
+
+	using vec2 = Vec<float, 2>;
+	using vec3 = Vec<float, 3>;
+	using vec4 = Vec<float, 4>;
+	using ivec2 = Vec<std::int32_t, 2>;
+	using ivec3 = Vec<std::int32_t, 3>;
+	using ivec4 = Vec<std::int32_t, 4>;
+	using uvec2 = Vec<std::uint32_t, 2>;
+	using uvec3 = Vec<std::uint32_t, 3>;
+	using uvec4 = Vec<std::uint32_t, 4>;
+
+	// Column major, every column padded to a vec4 which is what std140 (and std430 for three and four rows) expects
+	template<size_t Columns, size_t Rows>
+	struct Mat {
+		float data[Columns][4];
+		bool operator ==(const Mat& Other) const = default;
+	};
+
+	using mat2 = Mat<2, 2>;
+	using mat3 = Mat<3, 3>;
+	using mat4 = Mat<4, 4>;
+}
+
+namespace BufferLayout {
+	enum class Packing {
+		Std140,
+		Std430,
+	};
+
+	template<typename Member, size_t Offset>
+	struct Field {
+		using type = Member;
+		static constexpr size_t offset = Offset;
+	};
+
+	template<typename... Fields>
+	struct FieldList {};
+
+	// Specialize for every struct used in a buffer block:
+	// template<> struct BufferLayout::Block<Camera> { using Fields = BufferLayout::FieldList<BLOCK_FIELD(Camera, View), ...>; };
+	template<typename Struct>
+	struct Block {};
+
+	constexpr size_t roundUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	template<typename T, Packing P>
+	struct Rules;
+
+	template<typename Scalar, Packing P>
+		requires (std::same_as<Scalar, float> || std::same_as<Scalar, std::int32_t> || std::same_as<Scalar, std::uint32_t>)
+	struct Rules<Scalar, P> {
+		static constexpr size_t alignment = 4;
+		static constexpr size_t size = 4;
+	};
+
+	template<typename Scalar, size_t N, Packing P>
+	struct Rules<Glsl::Vec<Scalar, N>, P> {
+		static_assert(N >= 2 && N <= 4, "glsl only has vectors with two to four components");
+		static constexpr size_t alignment = (N == 2 ? 2 : 4) * Rules<Scalar, P>::size;
+		static constexpr size_t size = N * Rules<Scalar, P>::size;
+	};
+
+	// std140 rounds the alignment of array elements and structs up to the one of a vec4
+	template<Packing P>
+	constexpr size_t aggregateAlignment(size_t alignment) {
+		return P == Packing::Std140 ? roundUp(alignment, 16) : alignment;
+	}
+
+	template<typename T, size_t N, Packing P>
+	struct Rules<std::array<T, N>, P> {
+		static constexpr size_t alignment = aggregateAlignment<P>(Rules<T, P>::alignment);
+		static constexpr size_t stride = roundUp(Rules<T, P>::size, alignment);
+		static constexpr size_t size = N * stride;
+		static_assert(sizeof(T) == stride, "array element has a different size than the glsl array stride, use a vec4 sized element type");
+	};
+
+	template<size_t Columns, size_t Rows, Packing P>
+	struct Rules<Glsl::Mat<Columns, Rows>, P> {
+		static constexpr size_t alignment = aggregateAlignment<P>(Rules<Glsl::Vec<float, Rows>, P>::alignment);
+		static constexpr size_t stride = roundUp(Rules<Glsl::Vec<float, Rows>, P>::size, alignment);
+		static constexpr size_t size = Columns * stride;
+		static_assert(stride == 4 * sizeof(float), "matrix columns are padded to vec4, std430 packs two row matrices tighter");
+	};
+
+	template<Packing P, typename List>
+	struct FieldListRules;
+
+	template<Packing P, typename... Fields>
+	struct FieldListRules<P, FieldList<Fields...>> {
+		// Offsets glsl assigns to the members, the last entry is where the block ends
+		static constexpr std::array<size_t, sizeof...(Fields) + 1> offsets = [] {
+			std::array<size_t, sizeof...(Fields) + 1> result{};
+			size_t offset = 0;
+			size_t i = 0;
+			((offset = roundUp(offset, Rules<typename Fields::type, P>::alignment),
+			  result[i++] = offset,
+			  offset += Rules<typename Fields::type, P>::size), ...);
+			result[i] = offset;
+			return result;
+		}();
+
+		static constexpr size_t end = offsets.back();
+
+		static constexpr size_t alignment = std::max({size_t(4), Rules<typename Fields::type, P>::alignment...});
+
+		template<size_t I, typename F>
+		static constexpr bool checkField() {
+			static_assert(sizeof(typename F::type) == Rules<typename F::type, P>::size, "member has a different size than glsl expects");
+			static_assert(F::offset == offsets[I], "member offset does not match the glsl layout, reorder the members or add padding");
+			return true;
+		}
+
+		static constexpr bool valid = []<size_t... I>(std::index_sequence<I...>) {
+			return (checkField<I, Fields>() && ...);
+		}(std::index_sequence_for<Fields...>{});
+	};
+
+	// Nested structs (e.g. for arrays of lights) follow the same rules as the block itself
+	template<typename Struct, Packing P>
+		requires requires { typename Block<Struct>::Fields; }
+	struct Rules<Struct, P> {
+		using List = FieldListRules<P, typename Block<Struct>::Fields>;
+		static_assert(List::valid);
+		static constexpr size_t alignment = aggregateAlignment<P>(List::alignment);
+		static constexpr size_t size = roundUp(List::end, alignment);
+	};
+
+	template<typename Struct, Packing P>
+	constexpr bool matches() {
+		using List = FieldListRules<P, typename Block<Struct>::Fields>;
+		static_assert(List::valid);
+		static_assert(sizeof(Struct) >= List::end, "struct is smaller than the glsl block");
+		return true;
+	}
+}
+
+#define BLOCK_FIELD(Struct, member) BufferLayout::Field<decltype(Struct::member), offsetof(Struct, member)>
+
+// Owns the buffer behind an interface block, the binding point is shared by every program using the block
+class BlockBufferObject {
+protected:
+	GLuint BufferId = 0;
+	GLenum Target;
+	GLuint Binding;
+	GLsizeiptr Size;
+
+	BlockBufferObject(GLenum Target, GLuint Binding, GLsizeiptr Size, const void* Data);
+
+	void Upload(const void* Data, GLintptr Offset, GLsizeiptr Bytes);
+
+public:
+	BlockBufferObject(const BlockBufferObject&) = delete;
+	BlockBufferObject& operator=(const BlockBufferObject&) = delete;
+
+	BlockBufferObject(BlockBufferObject&& Other) noexcept;
+	BlockBufferObject& operator=(BlockBufferObject&& Other) noexcept;
+
+	virtual ~BlockBufferObject();
+
+	// Binds the buffer to its binding point again, only needed if someone else used the point in between
+	void bind() const;
+
+	GLuint GetId() const;
+	GLuint GetBinding() const;
+};
+
+template<typename T>
+class UniformBufferObject : public BlockBufferObject {
+	static_assert(std::is_trivially_copyable_v<T>);
+	static_assert(BufferLayout::matches<T, BufferLayout::Packing::Std140>());
+public:
+	UniformBufferObject(GLuint Binding, const T& Initial = {})
+		:BlockBufferObject(GL_UNIFORM_BUFFER, Binding, sizeof(T), &Initial) {}
+
+	void update(const T& Data) {
+		Upload(&Data, 0, sizeof(T));
+	}
+};
+
+template<typename T, BufferLayout::Packing P = BufferLayout::Packing::Std430>
+class ShaderStorageBufferObject : public BlockBufferObject {
+	static_assert(std::is_trivially_copyable_v<T>);
+	static_assert(BufferLayout::matches<T, P>());
+public:
+	ShaderStorageBufferObject(GLuint Binding, const T& Initial = {})
+		:BlockBufferObject(GL_SHADER_STORAGE_BUFFER, Binding, sizeof(T), &Initial) {}
+
+	void update(const T& Data) {
+		Upload(&Data, 0, sizeof(T));
+	}
+};
@@ -1,6 +1,36 @@
 ﻿#pragma once
 #include "pch.hpp"
 
+#include <cstdint>
+#include <string_view>
+
+//Stable 64 bit FNV-1a, used where hashes end up on disk and have to match between runs
+constexpr std::uint64_t fnv1aOffsetBasis = 14695981039346656037ull;
+
+constexpr std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = fnv1aOffsetBasis) {
+	for (const char c : data) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//A string literal usable as template argument, e.g. Uniform<"uTime", Shader::Data1f>
+template<size_t N>
+struct FixedString {
+	char data[N];
+
+	consteval FixedString(const char (&string)[N]) {
+		for (size_t i = 0; i < N; ++i) {
+			data[i] = string[i];
+		}
+	}
+
+	constexpr std::string_view view() const {
+		return {data, N - 1};
+	}
+};
+
 #ifndef NDEBUG
 
 extern void _GLGetError(const char* file, int line, const char* call);
@@ -4,13 +4,72 @@
 
 #include "Utilities.hpp"
 
+#include <cstdint>
+#include <map>
+#include <span>
+#include <tuple>
+
+//Vertex types list their attributes in a static constexpr tuple named Attributes, one VertexLayout::Attribute per shader
+//input in location order, e.g. std::tuple{VertexLayout::Attribute{&Vertex::x, 2}, VertexLayout::Attribute{&Vertex::r, 4, GL_TRUE}}.
+//An attribute starts at its member and spans Count components of the member's type, so x and y make up one vec2
+namespace VertexLayout {
+	template<typename Component>
+	constexpr GLenum componentType() {
+		if constexpr (std::same_as<Component, float>) return GL_FLOAT;
+		else if constexpr (std::same_as<Component, std::int8_t>) return GL_BYTE;
+		else if constexpr (std::same_as<Component, std::uint8_t>) return GL_UNSIGNED_BYTE;
+		else if constexpr (std::same_as<Component, std::int16_t>) return GL_SHORT;
+		else if constexpr (std::same_as<Component, std::uint16_t>) return GL_UNSIGNED_SHORT;
+		else if constexpr (std::same_as<Component, std::int32_t>) return GL_INT;
+		else if constexpr (std::same_as<Component, std::uint32_t>) return GL_UNSIGNED_INT;
+		else static_assert(sizeof(Component) == 0, "no vertex attribute type for this component type");
+	}
+
+	template<typename Vertex, typename Component>
+	struct Attribute {
+		Component Vertex::* Member;
+		GLint Count;
+		//Integer components are mapped to [0, 1] (or [-1, 1]) floats, e.g. colours stored as four bytes
+		GLboolean Normalized = GL_FALSE;
+		//Integer components read as ints/uints by the shader instead of converted to float
+		bool Integer = false;
+		GLenum Type = componentType<Component>();
+	};
+
+	template<typename Vertex, typename Component>
+	void prepareAttribute(GLuint VAO, GLuint Position, GLuint Binding, const Attribute<Vertex, Component>& Attrib) {
+		const Vertex Sample{};
+		const auto Offset = GLuint(reinterpret_cast<const std::byte*>(&(Sample.*Attrib.Member)) - reinterpret_cast<const std::byte*>(&Sample));
+		assert(Offset + Attrib.Count * sizeof(Component) <= sizeof(Vertex));
+
+		GLCALL(glEnableVertexArrayAttrib(VAO, Position));
+		if (Attrib.Integer) {
+			GLCALL(glVertexArrayAttribIFormat(VAO, Position, Attrib.Count, Attrib.Type, Offset));
+		}
+		else {
+			GLCALL(glVertexArrayAttribFormat(VAO, Position, Attrib.Count, Attrib.Type, Attrib.Normalized, Offset));
+		}
+		GLCALL(glVertexArrayAttribBinding(VAO, Position, Binding));
+	}
+
+	//Sets up the attributes of VertexType from Position on to read from the binding point
+	template<typename VertexType>
+	void prepare(GLuint VAO, GLuint& Position, GLuint Binding) {
+		std::apply([&](const auto&... Attrib) {
+			(prepareAttribute(VAO, Position++, Binding, Attrib), ...);
+		}, VertexType::Attributes);
+	}
+}
+
 struct CoordVertex {
 	float x;
 	float y;
 
 	bool operator ==(const CoordVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&CoordVertex::x, 2}
+	};
 };
 
 struct TextureAndCoordVertex {
@@ -22,7 +81,10 @@ struct TextureAndCoordVertex {
 
 	bool operator ==(const TextureAndCoordVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&TextureAndCoordVertex::x, 2},
+		VertexLayout::Attribute{&TextureAndCoordVertex::u, 2}
+	};
 };
 
 struct TransformationVertex {
@@ -35,7 +97,12 @@ struct TransformationVertex {
 
 	bool operator ==(const TransformationVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&TransformationVertex::Posx, 2},
+		VertexLayout::Attribute{&TransformationVertex::Sizex, 2},
+		VertexLayout::Attribute{&TransformationVertex::Rotation, 1},
+		VertexLayout::Attribute{&TransformationVertex::Scale, 1}
+	};
 };
 
 
@@ -49,7 +116,10 @@ struct CoordXYAndColourRGBVertex {
 
 	bool operator ==(const CoordXYAndColourRGBVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&CoordXYAndColourRGBVertex::x, 2},
+		VertexLayout::Attribute{&CoordXYAndColourRGBVertex::r, 3}
+	};
 };
 
 
@@ -64,7 +134,10 @@ struct CoordXYAndColourRGBAVertex {
 
 	bool operator ==(const CoordXYAndColourRGBAVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&CoordXYAndColourRGBAVertex::x, 2},
+		VertexLayout::Attribute{&CoordXYAndColourRGBAVertex::r, 4}
+	};
 };
 
 
@@ -79,7 +152,10 @@ struct CoordXYZAndColourRGBVertex {
 
 	bool operator ==(const CoordXYZAndColourRGBVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&CoordXYZAndColourRGBVertex::x, 3},
+		VertexLayout::Attribute{&CoordXYZAndColourRGBVertex::r, 3}
+	};
 };
 
 
@@ -95,27 +171,60 @@ struct CoordXYZAndColourRGBAVertex {
 
 	bool operator ==(const CoordXYZAndColourRGBAVertex& Other) const = default;
 
-	static void PrepareVBO(GLuint& Position, GLuint Instancingdivisor);
+	static constexpr auto Attributes = std::tuple{
+		VertexLayout::Attribute{&CoordXYZAndColourRGBAVertex::x, 3},
+		VertexLayout::Attribute{&CoordXYZAndColourRGBAVertex::r, 4}
+	};
 };
 
 class VertexBufferObjectDescriptor {
 public:
 	GLenum Usage;
 	GLuint Instancingdivisor;
+	GLsizei Stride;
 
 	GLsizei NumVerts = 0;
 
-	std::function<void(GLuint&, GLuint)> PrepareVBOVertexFunktion;
+	//Vertices the GPU storage has room for. It grows to at least double its size when NumVerts doesn't fit and
+	//only shrinks once ShrinkAfter updates in a row used less than a quarter of it, so sizes that bounce around don't reallocate
+	GLsizei Capacity = 0;
+	GLuint ShrinkAfter = 60;
+	GLuint SmallUpdates = 0;
+
+	void(*PrepareVBOVertexFunktion)(GLuint VAO, GLuint& Position, GLuint Binding);
 
-	void PrepareVBO(GLuint& Position);
+	void PrepareVBO(GLuint VAO, GLuint& Position, GLuint Binding);
 
 	GLuint VBO = GLuint(-1);
+
+	//Streaming buffers (Regions != 0) are a ring of regions in one persistently mapped buffer, every update
+	//writes into the next region and only waits if the GPU still reads from it
+	GLuint Regions = 0;
+	GLsizeiptr RegionBytes = 0;
+	GLuint Region = 0;
+	std::byte* Mapped = nullptr;
+	std::vector<GLsync> Fences;
+	//Without a mapping (the driver refused it) a streaming buffer is a plain one, written vertices are
+	//kept here and uploaded before the next draw
+	std::vector<std::byte> Staging;
+	bool StagingPending = false;
+
 	template<class VertexType>
 	//The VertexType is just a dummy object wich is unused, becaus Constructors can't have explicit template parameters
 	VertexBufferObjectDescriptor(GLenum Usage, VertexType, GLuint Instancingdivisor = 0)
-		:Usage(Usage), Instancingdivisor(Instancingdivisor), PrepareVBOVertexFunktion(VertexType::PrepareVBO)
+		:Usage(Usage), Instancingdivisor(Instancingdivisor), Stride(sizeof(VertexType)), PrepareVBOVertexFunktion(VertexLayout::prepare<VertexType>)
 	{}
 
+	//For geometry rewritten every frame, MaxVerts is only the initial size of a region, it grows when an update doesn't fit.
+	//Regions should be at least the number of frames the driver queues plus one
+	template<class VertexType>
+	static VertexBufferObjectDescriptor Streaming(VertexType Vertex, GLsizei MaxVerts, GLuint Regions = 3, GLuint Instancingdivisor = 0) {
+		VertexBufferObjectDescriptor Descriptor(GL_STREAM_DRAW, Vertex, Instancingdivisor);
+		Descriptor.Regions = std::max(Regions, 1u);
+		Descriptor.RegionBytes = GLsizeiptr(MaxVerts) * sizeof(VertexType);
+		return Descriptor;
+	}
+
 	//VertexBufferObjectDescriptor(const VertexBufferObjectDescriptor&) = delete;
 	//VertexBufferObjectDescriptor(VertexBufferObjectDescriptor&&) = delete;
 	//VertexBufferObjectDescriptor& operator=(const VertexBufferObjectDescriptor&) = delete;
@@ -138,10 +247,46 @@ public:
 	~PixelBufferObject();
 };
 
+class IndexBufferObject {
+public:
+	GLuint EBO = 0;
+	GLenum Usage = GL_STATIC_DRAW;
+	//GL_UNSIGNED_SHORT while every index fits, halving the buffer and what the vertex fetch reads
+	GLenum IndexType = GL_UNSIGNED_SHORT;
+	GLsizei NumIndices = 0;
+	GLsizeiptr CapacityBytes = 0;
+
+	IndexBufferObject() = default;
+	explicit IndexBufferObject(GLenum Usage);
+
+	IndexBufferObject(const IndexBufferObject&) = delete;
+	IndexBufferObject& operator=(const IndexBufferObject&) = delete;
+
+	IndexBufferObject(IndexBufferObject&& Other) noexcept;
+	IndexBufferObject& operator=(IndexBufferObject&& Other) noexcept;
+
+	~IndexBufferObject();
+
+	void Upload(std::span<const std::uint32_t> Indices);
+
+	size_t IndexSize() const;
+};
+
 class VertexArrayObject {
 private:
 	GLuint VAO = 0;
 	std::vector<VertexBufferObjectDescriptor> BufferDescriptors;
+	IndexBufferObject Elements;
+
+	//Number of instances the instanced buffers make up, 0 if there are none
+	GLsizei InstanceCount() const;
+
+	//False if the buffer couldn't be mapped, it is a plain buffer fed through Staging then
+	bool AllocateStream(VertexBufferObjectDescriptor& Descriptor);
+	void UploadStaged();
+	std::byte* NextStreamRegion(size_t BufferIndex, GLsizeiptr Bytes);
+	//Ranges are [begin, end) vertex indices, nullptr uploads everything
+	void UploadVertices(size_t BufferIndex, const void* Data, GLsizei Count, const std::vector<std::pair<size_t, size_t>>* Ranges = nullptr);
 public:
 
 	VertexArrayObject(std::vector<VertexBufferObjectDescriptor> InitialBufferDescriptors);
@@ -161,6 +306,33 @@ public:
 
 	void DrawAs(GLenum mode);
 
+	//Draws all indices of the element buffer, instanced like DrawAs
+	void DrawElementsAs(GLenum mode);
+
+	//Count indices from FirstIndex on, BaseVertex is added to every index (for several meshes sharing the buffers)
+	void DrawElementsAs(GLenum mode, GLsizei Count, GLsizei FirstIndex, GLint BaseVertex = 0);
+
+	//The element buffer is created with the first call, the index type is picked from the largest index.
+	//A different Usage than last time reallocates the buffer with the new hint
+	void ReplaceIndexBuffer(std::span<const std::uint32_t> Indices, GLenum Usage = GL_STATIC_DRAW);
+
+	const IndexBufferObject& GetElements() const;
+
+	GLuint GetId() const;
+
+	//Only for streaming buffers: the next region, to be filled with exactly Count vertices before the next draw.
+	//The memory is write combined, write it sequentially and never read from it
+	template<class VertexType>
+	std::span<VertexType> StreamVertexBuffer(size_t Count, size_t BufferIndex) {
+		assert(BufferIndex < BufferDescriptors.size());
+		auto& Descriptor = BufferDescriptors[BufferIndex];
+		assert(Descriptor.Regions != 0 && Descriptor.Stride == sizeof(VertexType));
+
+		auto* Region = NextStreamRegion(BufferIndex, GLsizeiptr(Count * sizeof(VertexType)));
+		Descriptor.NumVerts = (GLsizei)Count;
+		return { reinterpret_cast<VertexType*>(Region), Count };
+	}
+
 	template<class VertexType>
 	void ReplaceVertexBuffer(const std::vector<VertexType>& Vert, size_t BufferIndex) {
 		//if (Vert.empty()) return;
@@ -168,58 +340,146 @@ public:
 		assert(BufferIndex < BufferDescriptors.size());
 		auto& Descriptor = BufferDescriptors[BufferIndex];
 
-		if (Descriptor.NumVerts == (GLsizei)Vert.size()) {
-			GLCALL(glNamedBufferSubData(Descriptor.VBO, 0, Descriptor.NumVerts * sizeof(VertexType), Vert.data()));
+		if (Descriptor.Regions != 0 && Descriptor.Mapped) {
+			auto Region = StreamVertexBuffer<VertexType>(Vert.size(), BufferIndex);
+			std::copy(Vert.begin(), Vert.end(), Region.begin());
+			return;
 		}
-		else {
-			Descriptor.NumVerts = (GLsizei)Vert.size();
-			GLCALL(glNamedBufferData(Descriptor.VBO, Descriptor.NumVerts * sizeof(VertexType), Vert.data(), Descriptor.Usage));
+
+		assert(Descriptor.Stride == sizeof(VertexType));
+		UploadVertices(BufferIndex, Vert.data(), (GLsizei)Vert.size());
+	}
+
+	//Like ReplaceVertexBuffer but only uploads the [begin, end) ranges of Vert, the rest has to be in the buffer already.
+	//Falls back to uploading everything if the buffer has to be reallocated or is streaming
+	template<class VertexType>
+	void UpdateVertexBuffer(const std::vector<VertexType>& Vert, size_t BufferIndex, const std::vector<std::pair<size_t, size_t>>& Ranges) {
+		assert(BufferIndex < BufferDescriptors.size());
+		auto& Descriptor = BufferDescriptors[BufferIndex];
+
+		if (Descriptor.Regions != 0) {
+			ReplaceVertexBuffer(Vert, BufferIndex);
+			return;
 		}
+
+		assert(Descriptor.Stride == sizeof(VertexType));
+		UploadVertices(BufferIndex, Vert.data(), (GLsizei)Vert.size(), &Ranges);
 	}
 };
 
 
+//Remembers which vertices changed since the last upload, so replaceBuffer only uploads those.
+//Uploading into a different VAO or buffer index than last time uploads everything
 template<class VertexType>
 struct BufferedVertexVec {
 private:
 	std::vector<VertexType> Vertices;
-	bool Dirty = true;
+	//Changed [begin, end) ranges keyed by begin, never overlapping or touching
+	std::map<size_t, size_t> DirtyRanges;
+	size_t UploadedSize = size_t(-1);
+	//The buffer the dirty ranges are relative to
+	GLuint UploadedVAO = 0;
+	size_t UploadedIndex = 0;
+
+	void markDirty(size_t Begin, size_t End) {
+		if (Begin >= End) return;
+		auto It = DirtyRanges.upper_bound(Begin);
+		if (It != DirtyRanges.begin() && std::prev(It)->second >= Begin) {
+			--It;
+			Begin = It->first;
+		}
+		while (It != DirtyRanges.end() && It->first <= End) {
+			End = std::max(End, It->second);
+			It = DirtyRanges.erase(It);
+		}
+		DirtyRanges.emplace(Begin, End);
+	}
+
 public:
+	//Dirty ranges less than this many bytes apart are uploaded as one, a few bytes more are cheaper than another call
+	size_t MergeGapBytes = 4096;
 
 	void replaceBuffer(VertexArrayObject& VAO, size_t BufferIndex, bool ClearDirty = true) {
-		if (!Dirty)return;
-		VAO.ReplaceVertexBuffer(Vertices, BufferIndex);
-		if (ClearDirty)Dirty = false;
+		const bool FullUpload = UploadedSize == size_t(-1) || UploadedVAO != VAO.GetId() || UploadedIndex != BufferIndex;
+		if (!FullUpload && DirtyRanges.empty() && UploadedSize == Vertices.size()) return;
+
+		std::vector<std::pair<size_t, size_t>> Ranges;
+		const size_t MergeGap = MergeGapBytes / sizeof(VertexType);
+		for (auto [Begin, End] : DirtyRanges) {
+			End = std::min(End, Vertices.size());
+			if (Begin >= End) break;
+			if (!Ranges.empty() && Begin - Ranges.back().second <= MergeGap) {
+				Ranges.back().second = End;
+			}
+			else {
+				Ranges.emplace_back(Begin, End);
+			}
+		}
+
+		if (FullUpload) {
+			VAO.ReplaceVertexBuffer(Vertices, BufferIndex);
+		}
+		else {
+			VAO.UpdateVertexBuffer(Vertices, BufferIndex, Ranges);
+		}
+
+		if (ClearDirty) {
+			DirtyRanges.clear();
+			UploadedSize = Vertices.size();
+			UploadedVAO = VAO.GetId();
+			UploadedIndex = BufferIndex;
+		}
+	}
+
+	//Uploads everything with the next replaceBuffer
+	void markDirty() {
+		DirtyRanges.clear();
+		UploadedSize = size_t(-1);
 	}
 
 	void clear() {
-		Dirty = true;
 		Vertices.clear();
 	}
 
 	void append(const VertexType& Vertex) {
-		Dirty = true;
+		markDirty(Vertices.size(), Vertices.size() + 1);
 		Vertices.push_back(Vertex);
 	}
 
 	template<typename ...Args>
 	void emplace(Args&&... args) {
-		Dirty = true;
+		markDirty(Vertices.size(), Vertices.size() + 1);
 		Vertices.emplace_back(std::forward<Args>(args)...);
 	}
 
 	void append(const std::vector<VertexType>& Vertex) {
-		Dirty = true;
+		markDirty(Vertices.size(), Vertices.size() + Vertex.size());
 		Vertices.insert(Vertices.end(), Vertex.begin(), Vertex.end());
 	}
 
 	template<typename ...Args>
 	void appendOther(Args&&... Other) {
-		Dirty = true;
 		Vertices.reserve(Vertices.size() + (Other.Vertices.size() + ...));
 		(append(Other.Vertices), ...);
 	}
 
+	void set(size_t Index, const VertexType& Vertex) {
+		assert(Index < Vertices.size());
+		markDirty(Index, Index + 1);
+		Vertices[Index] = Vertex;
+	}
+
+	//For changing Count vertices from Index on in place, they are uploaded with the next replaceBuffer
+	std::span<VertexType> span(size_t Index, size_t Count) {
+		assert(Index + Count <= Vertices.size());
+		markDirty(Index, Index + Count);
+		return { Vertices.data() + Index, Count };
+	}
+
+	const VertexType& operator[](size_t Index) const {
+		return Vertices[Index];
+	}
+
 	bool empty() const {
 		return Vertices.empty();
 	}
@@ -233,25 +493,52 @@ public:
 	}
 };
 
-//struct IndexBufferObject {
-//	IndexBufferObject(void* data, uint32_t numIndices, uint8_t elementSize) {
-//		glGenBuffers(1, &bufferId);
-//		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
-//		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * elementSize, data, GL_STATIC_DRAW);
-//	}
-//
-//	virtual ~IndexBufferObject() {
-//		glDeleteBuffers(1, &bufferId);
-//	}
-//
-//	void bind() {
-//		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
-//	}
-//
-//	void unbind() {
-//		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-//	}
-//
-//private:
-//	GLuint bufferId;
-//};
+struct BufferedIndexVec {
+private:
+	std::vector<std::uint32_t> Indices;
+	bool Dirty = true;
+public:
+
+	void replaceBuffer(VertexArrayObject& VAO, GLenum Usage = GL_STATIC_DRAW, bool ClearDirty = true) {
+		if (!Dirty)return;
+		VAO.ReplaceIndexBuffer(Indices, Usage);
+		if (ClearDirty)Dirty = false;
+	}
+
+	void clear() {
+		Dirty = true;
+		Indices.clear();
+	}
+
+	void append(std::uint32_t Index) {
+		Dirty = true;
+		Indices.push_back(Index);
+	}
+
+	//Appends Other with BaseVertex added to every index, e.g. to merge meshes into one buffer
+	void append(std::span<const std::uint32_t> Other, std::uint32_t BaseVertex = 0) {
+		Dirty = true;
+		Indices.reserve(Indices.size() + Other.size());
+		for (const auto Index : Other) {
+			Indices.push_back(Index + BaseVertex);
+		}
+	}
+
+	void set(size_t Position, std::uint32_t Index) {
+		assert(Position < Indices.size());
+		Dirty = true;
+		Indices[Position] = Index;
+	}
+
+	bool empty() const {
+		return Indices.empty();
+	}
+
+	size_t size() const {
+		return Indices.size();
+	}
+
+	const std::vector<std::uint32_t>& data() const {
+		return Indices;
+	}
+};
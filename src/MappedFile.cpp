@@ -0,0 +1,57 @@
+#include "MappedFile.hpp"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef __unix__
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    size = (size_t)info.st_size;
+    if (size == 0) {
+      valid = true;
+    } else {
+      map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      valid = map != MAP_FAILED;
+      if (!valid) {
+        map = nullptr;
+      }
+    }
+  }
+  close(fd);
+#else
+  std::ifstream stream(path);
+  if (stream.is_open()) {
+    content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    valid = true;
+  }
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef __unix__
+  if (map) {
+    munmap(map, size);
+  }
+#endif
+}
+
+bool MappedFile::isValid() const {
+  return valid;
+}
+
+std::string_view MappedFile::text() const {
+#ifdef __unix__
+  return map ? std::string_view(static_cast<const char*>(map), size) : std::string_view();
+#else
+  return content;
+#endif
+}
@@ -0,0 +1,264 @@
+#include "MeshOptimization.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace MeshOptimization {
+	std::uint64_t hashBytes(const std::byte* Data, size_t Bytes) {
+		constexpr std::uint64_t Multiplier = 0x9E3779B97F4A7C15ull;
+		std::uint64_t Hash = Bytes * Multiplier;
+		size_t i = 0;
+		for (; i + 8 <= Bytes; i += 8) {
+			std::uint64_t Word;
+			std::memcpy(&Word, Data + i, 8);
+			Hash = (std::rotl(Hash, 29) ^ Word) * Multiplier;
+		}
+		if (i < Bytes) {
+			std::uint64_t Word = 0;
+			std::memcpy(&Word, Data + i, Bytes - i);
+			Hash = (std::rotl(Hash, 29) ^ Word) * Multiplier;
+		}
+		return Hash ^ (Hash >> 32);
+	}
+
+	std::vector<std::uint32_t> buildIndices(const std::byte* Vertices, size_t Count, size_t Stride, EqualFunction Equal, std::uint32_t& UniqueCount, unsigned Threads) {
+		assert(Count < std::numeric_limits<std::uint32_t>::max());
+		constexpr std::uint32_t Empty = std::numeric_limits<std::uint32_t>::max();
+
+		if (Count < ParallelThreshold) {
+			Threads = 1;
+		}
+		else if (Threads == 0) {
+			Threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		auto RunOnThreads = [Threads](auto&& Work) {
+			if (Threads == 1) {
+				Work(0u);
+				return;
+			}
+			std::vector<std::jthread> Workers;
+			for (unsigned t = 0; t < Threads; ++t) {
+				Workers.emplace_back(Work, t);
+			}
+		};
+
+		std::vector<std::uint64_t> Hashes(Count);
+		RunOnThreads([&](unsigned t) {
+			const size_t Begin = Count * t / Threads;
+			const size_t End = Count * (t + 1) / Threads;
+			for (size_t i = Begin; i < End; ++i) {
+				Hashes[i] = hashBytes(Vertices + i * Stride, Stride);
+			}
+		});
+
+		// Every thread owns the vertices whose hash falls into its shard and walks them in order,
+		// so the first of equal vertices is always the one that ends up in the table
+		std::vector<std::uint32_t> First(Count);
+		RunOnThreads([&](unsigned t) {
+			// Sized for a few duplicates per vertex, it grows if there are fewer
+			std::vector<std::uint32_t> Table(std::bit_ceil(std::max<size_t>(Count / Threads / 2, 16)), Empty);
+			size_t Used = 0;
+
+			auto Home = [&](std::uint64_t Hash) {
+				return size_t(Hash / Threads) & (Table.size() - 1);
+			};
+
+			for (size_t i = 0; i < Count; ++i) {
+				if (Hashes[i] % Threads != t) continue;
+
+				size_t Slot = Home(Hashes[i]);
+				while (Table[Slot] != Empty) {
+					const std::uint32_t Other = Table[Slot];
+					if (Hashes[Other] == Hashes[i] && Equal(Vertices + Other * Stride, Vertices + i * Stride)) {
+						break;
+					}
+					Slot = (Slot + 1) & (Table.size() - 1);
+				}
+
+				if (Table[Slot] != Empty) {
+					First[i] = Table[Slot];
+					continue;
+				}
+
+				Table[Slot] = (std::uint32_t)i;
+				First[i] = (std::uint32_t)i;
+
+				// Kept at most half full, the shards are only about equally sized on average
+				if (++Used * 2 > Table.size()) {
+					auto Old = std::move(Table);
+					Table.assign(Old.size() * 2, Empty);
+					for (const auto Index : Old) {
+						if (Index == Empty) continue;
+						size_t Target = Home(Hashes[Index]);
+						while (Table[Target] != Empty) {
+							Target = (Target + 1) & (Table.size() - 1);
+						}
+						Table[Target] = Index;
+					}
+				}
+			}
+		});
+
+		std::vector<std::uint32_t> Indices(Count);
+		UniqueCount = 0;
+		for (size_t i = 0; i < Count; ++i) {
+			Indices[i] = First[i] == i ? UniqueCount++ : Indices[First[i]];
+		}
+		return Indices;
+	}
+
+	namespace {
+		constexpr int CacheSize = 32;
+
+		// Weights from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+		float vertexScore(int CachePosition, std::uint32_t Remaining) {
+			if (Remaining == 0) {
+				return -1.0f;
+			}
+
+			float Score = 0.0f;
+			if (CachePosition >= 0) {
+				if (CachePosition < 3) {
+					// The vertices of the last triangle get a fixed score, otherwise the next triangle would be
+					// chosen by which of them happens to be first
+					Score = 0.75f;
+				}
+				else {
+					const float Scaler = 1.0f / (CacheSize - 3);
+					Score = std::pow(1.0f - (CachePosition - 3) * Scaler, 1.5f);
+				}
+			}
+
+			// Favours vertices with few triangles left, so lone triangles aren't left behind
+			return Score + 2.0f / std::sqrt(float(Remaining));
+		}
+	}
+
+	void optimizeVertexCache(std::span<std::uint32_t> Indices, size_t VertexCount) {
+		assert(Indices.size() % 3 == 0);
+		const size_t TriangleCount = Indices.size() / 3;
+		if (TriangleCount == 0) return;
+
+		// Triangles of every vertex, the first Remaining[v] of its range are the ones not emitted yet
+		std::vector<std::uint32_t> Offsets(VertexCount + 1, 0);
+		for (const auto Index : Indices) {
+			assert(Index < VertexCount);
+			++Offsets[Index + 1];
+		}
+		for (size_t v = 0; v < VertexCount; ++v) {
+			Offsets[v + 1] += Offsets[v];
+		}
+
+		std::vector<std::uint32_t> Remaining(VertexCount, 0);
+		std::vector<std::uint32_t> Adjacency(Indices.size());
+		for (size_t t = 0; t < TriangleCount; ++t) {
+			for (size_t k = 0; k < 3; ++k) {
+				const auto v = Indices[t * 3 + k];
+				Adjacency[Offsets[v] + Remaining[v]++] = (std::uint32_t)t;
+			}
+		}
+
+		std::vector<int> CachePosition(VertexCount, -1);
+		std::vector<float> VertexScores(VertexCount);
+		for (size_t v = 0; v < VertexCount; ++v) {
+			VertexScores[v] = vertexScore(-1, Remaining[v]);
+		}
+
+		std::vector<float> TriangleScores(TriangleCount);
+		for (size_t t = 0; t < TriangleCount; ++t) {
+			TriangleScores[t] = VertexScores[Indices[t * 3]] + VertexScores[Indices[t * 3 + 1]] + VertexScores[Indices[t * 3 + 2]];
+		}
+
+		std::vector<bool> Emitted(TriangleCount, false);
+		std::vector<std::uint32_t> Output;
+		Output.reserve(Indices.size());
+
+		// Three more than the cache so the vertices pushed out by a triangle can still be updated
+		std::vector<std::uint32_t> Cache, NextCache;
+		Cache.reserve(CacheSize + 3);
+		NextCache.reserve(CacheSize + 3);
+
+		size_t Best = std::max_element(TriangleScores.begin(), TriangleScores.end()) - TriangleScores.begin();
+		size_t Cursor = 0;
+
+		for (size_t Count = 0; Count < TriangleCount; ++Count) {
+			// No triangle in the cache has vertices left, continue with the next one in input order
+			if (Best == size_t(-1)) {
+				while (Emitted[Cursor]) {
+					++Cursor;
+				}
+				Best = Cursor;
+			}
+
+			const std::uint32_t* Triangle = &Indices[Best * 3];
+			Output.insert(Output.end(), Triangle, Triangle + 3);
+			Emitted[Best] = true;
+
+			NextCache.assign(Triangle, Triangle + 3);
+			for (const auto v : Cache) {
+				if (v != Triangle[0] && v != Triangle[1] && v != Triangle[2]) {
+					NextCache.push_back(v);
+				}
+			}
+
+			for (size_t k = 0; k < 3; ++k) {
+				const auto v = Triangle[k];
+				auto* Begin = &Adjacency[Offsets[v]];
+				auto* End = Begin + Remaining[v];
+				*std::find(Begin, End, (std::uint32_t)Best) = End[-1];
+				--Remaining[v];
+			}
+
+			for (size_t i = 0; i < NextCache.size(); ++i) {
+				const auto v = NextCache[i];
+				CachePosition[v] = i < CacheSize ? int(i) : -1;
+
+				const float Score = vertexScore(CachePosition[v], Remaining[v]);
+				const float Delta = Score - VertexScores[v];
+				VertexScores[v] = Score;
+
+				for (size_t j = Offsets[v]; j < Offsets[v] + Remaining[v]; ++j) {
+					TriangleScores[Adjacency[j]] += Delta;
+				}
+			}
+
+			// Only once every vertex changed its triangles' scores, a triangle sharing several of them
+			// would otherwise be picked on a score that isn't final
+			Best = size_t(-1);
+			float BestScore = -1.0f;
+			for (const auto v : NextCache) {
+				for (size_t j = Offsets[v]; j < Offsets[v] + Remaining[v]; ++j) {
+					const auto t = Adjacency[j];
+					if (TriangleScores[t] > BestScore) {
+						BestScore = TriangleScores[t];
+						Best = t;
+					}
+				}
+			}
+
+			if (NextCache.size() > CacheSize) {
+				NextCache.resize(CacheSize);
+			}
+			std::swap(Cache, NextCache);
+		}
+
+		std::copy(Output.begin(), Output.end(), Indices.begin());
+	}
+
+	std::vector<std::uint32_t> optimizeVertexFetch(std::span<std::uint32_t> Indices, size_t VertexCount, std::uint32_t& UsedCount) {
+		constexpr std::uint32_t Unused = std::numeric_limits<std::uint32_t>::max();
+		std::vector<std::uint32_t> Remap(VertexCount, Unused);
+		UsedCount = 0;
+		for (auto& Index : Indices) {
+			assert(Index < VertexCount);
+			if (Remap[Index] == Unused) {
+				Remap[Index] = UsedCount++;
+			}
+			Index = Remap[Index];
+		}
+		return Remap;
+	}
+}
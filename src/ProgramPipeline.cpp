@@ -0,0 +1,71 @@
+#include "ProgramPipeline.hpp"
+
+#include "Utilities.hpp"
+
+ProgramPipeline::ProgramPipeline(std::initializer_list<const Shader*> Programs)
+	:Programs(Programs) {
+	GLCALL(glCreateProgramPipelines(1, &PipelineId));
+	for (const Shader* Program : Programs) {
+		GLCALL(glUseProgramStages(PipelineId, Program->stageBits(), Program->GetId()));
+	}
+}
+
+ProgramPipeline::~ProgramPipeline() {
+	GLCALL(glDeleteProgramPipelines(1, &PipelineId));
+}
+
+void ProgramPipeline::bind() const {
+	GLCALL(glBindProgramPipeline(PipelineId));
+	for (const Shader* Program : Programs) {
+		Program->flush();
+	}
+}
+
+bool ProgramPipeline::validate() const {
+	GLCALL(glValidateProgramPipeline(PipelineId));
+	GLint Valid = GL_FALSE;
+	GLCALL(glGetProgramPipelineiv(PipelineId, GL_VALIDATE_STATUS, &Valid));
+	if (Valid != GL_TRUE) {
+		ERRORLOG("Program pipeline validation failed");
+	}
+	return Valid == GL_TRUE;
+}
+
+void ProgramPipeline::unbind() const {
+#ifndef NDEBUG
+	GLCALL(glBindProgramPipeline(0));
+#endif
+}
+
+void ProgramPipeline::setActiveProgram(const Shader& Program) const {
+	GLCALL(glActiveShaderProgram(PipelineId, Program.GetId()));
+}
+
+GLuint ProgramPipeline::GetId() const {
+	return PipelineId;
+}
+
+ProgramPipeline& ProgramPipelineCache::get(std::initializer_list<const Shader*> Programs) {
+	Key key{};
+	for (const Shader* Program : Programs) {
+		for (size_t i = 0; i < key.size(); ++i) {
+			if (Program->stageBits() & Shader::stageBit(Shader::ShaderType(i))) {
+				key[i] = Program->GetId();
+			}
+		}
+	}
+
+	auto& Pipeline = Pipelines[key];
+	if (!Pipeline) {
+		Pipeline = std::make_unique<ProgramPipeline>(Programs);
+	}
+	return *Pipeline;
+}
+
+void ProgramPipelineCache::clear() {
+	Pipelines.clear();
+}
+
+size_t ProgramPipelineCache::size() const {
+	return Pipelines.size();
+}
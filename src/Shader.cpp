@@ -1,54 +1,469 @@
 #include "Shader.hpp"
 
+#include "ShaderArchive.hpp"
+#include "ShaderBinaryCache.hpp"
+#include "ShaderSourceCache.hpp"
 #include "Utilities.hpp"
 
-GLuint Shader::compile(const std::string &shaderSource, GLenum type,
-                       ErrorHandler err) {
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <span>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::uint32_t spirVMagic = 0x07230203;
+
+GLuint Shader::compileSpirV(const SpirV& module, GLenum type) {
+  GLuint id = GLCALL(glCreateShader(type));
+
+  // Not every driver survives being handed something else, without a module the compile status stays false
+  if (module.code.size() < 5 || module.code[0] != spirVMagic) {
+    return id;
+  }
+
+  GLCALL(glShaderBinary(1, &id, GL_SHADER_BINARY_FORMAT_SPIR_V, module.code.data(),
+                        (GLsizei)(module.code.size() * sizeof(std::uint32_t))));
+  std::vector<GLuint> indices;
+  std::vector<GLuint> values;
+  for (const auto& [index, value] : module.constants) {
+    indices.push_back(index);
+    values.push_back(value);
+  }
+  // Core since 4.6, older contexts only have the extension entry point
+  const auto specialize = glSpecializeShader ? glSpecializeShader : glSpecializeShaderARB;
+  GLCALL(specialize(id, module.entryPoint.c_str(), (GLuint)indices.size(), indices.data(), values.data()));
+
+  return id;
+}
+
+GLuint Shader::compile(const std::string &shaderSource, GLenum type) {
   GLuint id = GLCALL(glCreateShader(type));
 
   const char *src = shaderSource.c_str();
   GLCALL(glShaderSource(id, 1, &src, 0));
   GLCALL(glCompileShader(id));
 
+  return id;
+}
+
+bool Shader::compileStatus(GLuint id, ShaderType type, const std::string &shaderSource,
+                           ErrorHandler err) {
   int result;
   GLCALL(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
   if (result != GL_TRUE) {
     int length = 0;
     GLCALL(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length));
-    char *message = new char[length];
+    // A shader that never got a source or module has an empty log
+    char *message = new char[std::max(length, 1)]{};
     GLCALL(glGetShaderInfoLog(id, length, &length, message));
 
-    std::string ShaderType;
-    if (type == GL_VERTEX_SHADER)
-      ShaderType = "Vertex Shader";
-    if (type == GL_FRAGMENT_SHADER)
-      ShaderType = "Fragment Shader";
-
-    err("Shader compilation faild", "With Shadertype: " + ShaderType +
-                                        "\nError: \n" + std::string(message) +
+    err("Shader compilation faild", "With Shadertype: " + std::string(shaderTypeToName.at((unsigned char)type)) +
+                                        " Shader\nError: \n" + std::string(message) +
                                         "\nShader Source: \n" + shaderSource);
     delete[] message;
-    return 0;
+    return false;
   }
 
-  return id;
+  return true;
 }
 
 std::string Shader::parse(const std::filesystem::path &filename,
-                          ErrorHandler err) {
-  std::ifstream file(filename);
+                          ErrorHandler err, std::vector<std::filesystem::path>& dependencies) {
+  return ShaderSourceCache::global().resolve(filename, err, dependencies);
+}
+
+std::string Shader::read(const ShaderSource& source, ErrorHandler err, std::vector<std::filesystem::path>* dependencies) {
+  Visitor shaderReader{
+    [](const std::string content) {
+      return content;
+    },
+    [](const std::string_view content) {
+      return std::string(content);
+    },
+    [err, dependencies](const SpirV& module) {
+      if (std::holds_alternative<std::monostate>(module.fallback)) {
+        err("Missing glsl fallback", "The driver has no GL_ARB_gl_spirv and the SPIR-V module has no glsl fallback");
+        return std::string();
+      }
+      const ShaderSource fallback = std::visit(Visitor{
+        [](std::monostate) { return ShaderSource(); },
+        [](const auto& text) { return ShaderSource(text); },
+      }, module.fallback);
+      return read(fallback, err, dependencies);
+    },
+    [err, dependencies](const std::filesystem::path& path) {
+      std::vector<std::filesystem::path> files;
+      auto content = parse(path, err, files);
+      if (dependencies) {
+        for (auto& file : files) {
+          if (std::ranges::find(*dependencies, file) == dependencies->end()) {
+            dependencies->push_back(std::move(file));
+          }
+        }
+      }
+      return content;
+    }
+  };
+  return std::visit(shaderReader, source);
+}
+
+std::vector<std::uint32_t> Shader::readSpirV(const std::filesystem::path& file, ErrorHandler err) {
+  std::ifstream stream(file, std::ios::binary);
+  if (!stream.is_open()) {
+    err("Faild to open File", "Faild to open : " + file.string());
+    return {};
+  }
+  std::vector<char> bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  std::vector<std::uint32_t> code(bytes.size() / sizeof(std::uint32_t));
+  std::memcpy(code.data(), bytes.data(), code.size() * sizeof(std::uint32_t));
+  if (bytes.size() % sizeof(std::uint32_t) != 0 || code.empty() || code[0] != spirVMagic) {
+    err("Invalid SPIR-V module", file.string() + " is not a SPIR-V module");
+    return {};
+  }
+  return code;
+}
+
+std::uint64_t Shader::binaryKey(const std::vector<std::tuple<ShaderType, std::string>>& shaderContents, bool separable) {
+  std::uint64_t key = fnv1a(separable ? "separable" : "");
+  for (const auto& [type, content] : shaderContents) {
+    key = fnv1a(shaderTypeToName.at((unsigned char)type), key);
+    key = fnv1a(content, key);
+  }
+  // The same fingerprint an archive records, so its keys and its fingerprint always describe the same driver
+  const std::uint64_t fingerprint = driverFingerprint();
+  return fnv1a(std::string_view(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint)), key);
+}
+
+std::uint64_t Shader::driverFingerprint() {
+  std::uint64_t fingerprint = fnv1aOffsetBasis;
+  for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const GLubyte* str = glGetString(name);
+    if (str) {
+      fingerprint = fnv1a(reinterpret_cast<const char*>(str), fingerprint);
+    }
+  }
+  return fingerprint;
+}
+
+bool Shader::loadBinary(GLenum binaryFormat, const void* binary, size_t length) {
+  int numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  std::vector<GLint> formats(numFormats);
+  glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+  if (std::ranges::find(formats, (GLint)binaryFormat) == formats.end()) {
+    return false;
+  }
+
+  GLCALL(glProgramBinary(shaderId, binaryFormat, binary, (GLsizei)length));
+  int result;
+  GLCALL(glGetProgramiv(shaderId, GL_LINK_STATUS, &result));
+  // The driver rejects binaries it can no longer use, the caller falls back to the sources
+  return result == GL_TRUE;
+}
+
+bool Shader::loadBinary(const std::filesystem::path& binaryLocation, std::uint64_t key) {
+  std::ifstream format(binaryLocation.parent_path() / (binaryLocation.stem().string() + ".format"));
+  if (!format.is_open()) {
+    return false;
+  }
+  GLenum binaryFormat = 0;
+  std::uint64_t storedKey = 0;
+  format >> std::hex >> binaryFormat >> storedKey;
+  if (!format || storedKey != key) {
+    return false;
+  }
+
+  std::ifstream file(binaryLocation, std::ios::binary);
   if (!file.is_open()) {
-    err("Faild to open File", "Faild to open : " + filename.string());
-    return "";
+    return false;
+  }
+  std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return loadBinary(binaryFormat, binary.data(), binary.size());
+}
+
+void Shader::saveBinary(const std::filesystem::path& binaryLocation, std::uint64_t key) const {
+  int numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  if(numFormats == 0) {
+    std::ofstream off(binaryLocation.parent_path() / "Zero binary formats suppoerted");
+    return;
+  }
+
+  const auto program = binary();
+  if (!program) {
+    return;
+  }
+
+  std::ofstream off(binaryLocation, std::ios::binary);
+  off.write(reinterpret_cast<const char*>(program->data.data()), (std::streamsize)program->data.size());
+  std::ofstream format(binaryLocation.parent_path() / (binaryLocation.stem().string() + ".format"));
+  format << std::hex << program->format << "\n" << key << "\n";
+}
+
+std::optional<Shader::Binary> Shader::binary() const {
+  wait();
+  if (shaderId == 0) {
+    return std::nullopt;
+  }
+  int numFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  if (numFormats == 0) {
+    return std::nullopt;
   }
-  std::stringstream contentStream;
-  contentStream << file.rdbuf();
-  file.close();
 
-  return contentStream.str();
+  GLint length = 0;
+  GLCALL(glGetProgramiv(shaderId, GL_PROGRAM_BINARY_LENGTH, &length));
+  Binary result{0, programKey, std::vector<std::byte>(length)};
+  GLCALL(glGetProgramBinary(shaderId, length, &length, &result.format, result.data.data()));
+  if (length == 0) {
+    return std::nullopt;
+  }
+  result.data.resize(length);
+  return result;
+}
+
+static std::uint32_t uniformTypeSize(GLenum type) {
+  switch (type) {
+  case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+    return 2 * 4;
+  case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+    return 3 * 4;
+  case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+  case GL_FLOAT_MAT2:
+    return 4 * 4;
+  case GL_FLOAT_MAT3:
+    return 9 * 4;
+  case GL_FLOAT_MAT4:
+    return 16 * 4;
+  case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+    return 6 * 4;
+  case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+    return 8 * 4;
+  case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+    return 12 * 4;
+  case GL_DOUBLE:
+    return 8;
+  case GL_DOUBLE_VEC2:
+    return 2 * 8;
+  case GL_DOUBLE_VEC3:
+    return 3 * 8;
+  case GL_DOUBLE_VEC4: case GL_DOUBLE_MAT2:
+    return 4 * 8;
+  case GL_DOUBLE_MAT3:
+    return 9 * 8;
+  case GL_DOUBLE_MAT4:
+    return 16 * 8;
+  case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT3x2:
+    return 6 * 8;
+  case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT4x2:
+    return 8 * 8;
+  case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x3:
+    return 12 * 8;
+  default:
+    // Scalars, bools, samplers and images are all set as one 32 bit value
+    return 4;
+  }
+}
+
+Shader::UniformSetter Shader::uniformSetter(GLenum type) {
+  switch (type) {
+  case GL_FLOAT:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform1fv(p, l, n, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_VEC2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform2fv(p, l, n, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_VEC3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform3fv(p, l, n, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_VEC4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform4fv(p, l, n, static_cast<const GLfloat*>(v))); };
+  case GL_INT: case GL_BOOL:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform1iv(p, l, n, static_cast<const GLint*>(v))); };
+  case GL_INT_VEC2: case GL_BOOL_VEC2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform2iv(p, l, n, static_cast<const GLint*>(v))); };
+  case GL_INT_VEC3: case GL_BOOL_VEC3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform3iv(p, l, n, static_cast<const GLint*>(v))); };
+  case GL_INT_VEC4: case GL_BOOL_VEC4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform4iv(p, l, n, static_cast<const GLint*>(v))); };
+  case GL_UNSIGNED_INT:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform1uiv(p, l, n, static_cast<const GLuint*>(v))); };
+  case GL_UNSIGNED_INT_VEC2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform2uiv(p, l, n, static_cast<const GLuint*>(v))); };
+  case GL_UNSIGNED_INT_VEC3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform3uiv(p, l, n, static_cast<const GLuint*>(v))); };
+  case GL_UNSIGNED_INT_VEC4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform4uiv(p, l, n, static_cast<const GLuint*>(v))); };
+  case GL_FLOAT_MAT2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix2fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix3fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix4fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT2x3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix2x3fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT3x2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix3x2fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT2x4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix2x4fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT4x2:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix4x2fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT3x4:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix3x4fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_FLOAT_MAT4x3:
+    return [](GLuint p, GLint l, GLsizei n, GLboolean t, const void* v) { GLCALL(glProgramUniformMatrix4x3fv(p, l, n, t, static_cast<const GLfloat*>(v))); };
+  case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+  case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+  case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT3x2: case GL_DOUBLE_MAT2x4:
+  case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x3:
+    // There is no UniformData for doubles
+    return nullptr;
+  default:
+    // Samplers and images, set to the unit they read from
+    return [](GLuint p, GLint l, GLsizei n, GLboolean, const void* v) { GLCALL(glProgramUniform1iv(p, l, n, static_cast<const GLint*>(v))); };
+  }
+}
+
+#ifndef NDEBUG
+// Whether data of dataType (a Data*::glType) may be applied to a uniform declared as uniformType
+static bool uniformAccepts(GLenum uniformType, GLenum dataType) {
+  if (uniformType == dataType) {
+    return true;
+  }
+  switch (uniformType) {
+  case GL_BOOL:
+    return dataType == GL_INT || dataType == GL_UNSIGNED_INT;
+  case GL_BOOL_VEC2:
+    return dataType == GL_INT_VEC2 || dataType == GL_UNSIGNED_INT_VEC2;
+  case GL_BOOL_VEC3:
+    return dataType == GL_INT_VEC3 || dataType == GL_UNSIGNED_INT_VEC3;
+  case GL_BOOL_VEC4:
+    return dataType == GL_INT_VEC4 || dataType == GL_UNSIGNED_INT_VEC4;
+  case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+  case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+  case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+  case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+  case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT2x4:
+  case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+    return false;
+  default:
+    // Samplers and images
+    return dataType == GL_INT;
+  }
+}
+#endif
+
+static GLint activeResources(GLuint program, GLenum interface) {
+  GLint count = 0;
+  GLCALL(glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &count));
+  return count;
+}
+
+template<size_t N>
+static std::array<GLint, N> resourceProperties(GLuint program, GLenum interface, GLuint index, const std::array<GLenum, N>& properties) {
+  std::array<GLint, N> values{};
+  GLCALL(glGetProgramResourceiv(program, interface, index, N, properties.data(), N, nullptr, values.data()));
+  return values;
 }
 
-Shader::Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const std::optional<std::filesystem::path>& binaryLocation) {
+// length is GL_NAME_LENGTH, which counts the terminating null
+static std::string resourceName(GLuint program, GLenum interface, GLuint index, GLint length) {
+  std::string name(std::max(length, 1), '\0');
+  GLCALL(glGetProgramResourceName(program, interface, index, length, nullptr, name.data()));
+  name.resize(name.size() - 1);
+  return name;
+}
+
+void Shader::reflect() const {
+  const auto start = Clock::now();
+  static std::atomic<std::uint32_t> generations = 0;
+  generation = ++generations;
+  reflected = {};
+  uniformInfo.clear();
+  uniformNames.clear();
+  dirtySlots.clear();
+
+  for (const auto& [interface, blocks] : {std::pair{GL_UNIFORM_BLOCK, &reflected.uniformBlocks},
+                                         std::pair{GL_SHADER_STORAGE_BLOCK, &reflected.storageBlocks}}) {
+    const GLint count = activeResources(shaderId, interface);
+    for (GLint i = 0; i < count; ++i) {
+      const auto [length, binding, dataSize, variables] = resourceProperties(shaderId, interface, i,
+          std::array<GLenum, 4>{GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES});
+      blocks->push_back({resourceName(shaderId, interface, i, length), binding, dataSize, variables});
+    }
+  }
+
+  const GLint inputs = activeResources(shaderId, GL_PROGRAM_INPUT);
+  for (GLint i = 0; i < inputs; ++i) {
+    const auto [length, type, arraySize, location] = resourceProperties(shaderId, GL_PROGRAM_INPUT, i,
+        std::array<GLenum, 4>{GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION});
+    // Built ins like gl_VertexID have no location
+    if (location == -1) {
+      continue;
+    }
+    reflected.attributes.push_back({resourceName(shaderId, GL_PROGRAM_INPUT, i, length), (GLenum)type, arraySize, location});
+  }
+
+  std::vector<NameEntry> names;
+  std::vector<NameEntry> aliases;
+  std::vector<std::string> slotNames;
+  std::uint32_t shadowSize = 0;
+  const GLint uniforms = activeResources(shaderId, GL_UNIFORM);
+  for (GLint i = 0; i < uniforms; ++i) {
+    const auto [length, type, arraySize, location, blockIndex, offset] = resourceProperties(shaderId, GL_UNIFORM, i,
+        std::array<GLenum, 6>{GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET});
+    const auto& uniform = reflected.uniforms.emplace_back(Reflection::Uniform{
+        resourceName(shaderId, GL_UNIFORM, i, length), (GLenum)type, arraySize, location, blockIndex, offset});
+    // Members of uniform blocks have no location and can't be set with glUniform*
+    if (location == -1) {
+      continue;
+    }
+    const std::uint32_t bytes = uniformTypeSize(uniform.type) * (std::uint32_t)arraySize;
+    const auto slot = (std::uint32_t)uniformInfo.size();
+    names.push_back({fnv1a(uniform.name), slot});
+    // Arrays are reported as "name[0]", glGetUniformLocation also takes the plain name
+    if (uniform.name.ends_with("[0]")) {
+      aliases.push_back({fnv1a(std::string_view(uniform.name).substr(0, uniform.name.size() - 3)), slot});
+    }
+    uniformInfo.push_back({location, uniform.type, arraySize, uniformSetter(uniform.type), shadowSize, bytes, 0, false, false, GL_FALSE});
+    slotNames.push_back(uniform.name);
+    shadowSize += bytes;
+  }
+  uniformShadow.assign(shadowSize, std::byte{0});
+
+  uniformNames.assign(std::bit_ceil(2 * (names.size() + aliases.size()) + 1), NameEntry{0, UniformHandle::invalid});
+  const size_t mask = uniformNames.size() - 1;
+  const auto insert = [&](const NameEntry& name, bool alias) {
+    for (size_t i = name.hash & mask;; i = (i + 1) & mask) {
+      auto& entry = uniformNames[i];
+      if (entry.slot == UniformHandle::invalid) {
+        entry = name;
+        return;
+      }
+      if (entry.hash == name.hash) {
+        // An alias never replaces a real name
+        if (!alias && entry.slot != NameEntry::ambiguous) {
+          origin->err("Uniform name collision", "The uniform names " + slotNames[entry.slot] + " and " + slotNames[name.slot] +
+                      " have the same hash, neither can be set by name, rename one of them");
+          entry.slot = NameEntry::ambiguous;
+        }
+        return;
+      }
+    }
+  };
+  for (const auto& name : names) {
+    insert(name, false);
+  }
+  for (const auto& alias : aliases) {
+    insert(alias, true);
+  }
+  timing.reflection = Clock::now() - start;
+}
+
+Shader::Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const std::optional<std::filesystem::path>& binaryLocation)
+  : Shader(err, shaders, Descriptor{binaryLocation}) {}
+
+Shader::Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const Descriptor& desc)
+  : origin(std::make_shared<const Origin>(Origin{err, shaders, desc})), label(desc.label) {
   shaderId = glCreateProgram();
   GLenum error = glGetError();
   if (shaderId == 0) {
@@ -60,114 +475,297 @@ Shader::Shader(ErrorHandler err, const std::vector<ShaderInfo>& shaders, const s
     return;
   }
 
-  Visitor shaderReader{
-    [](const std::string content) {
-      return content;
-    },
-    [err](const std::filesystem::path& path) {
-      return parse(path, err);
-    }
-  };
+  pending = std::make_unique<Pending>();
+  pending->err = err;
+  pending->binaryLocation = desc.binaryLocation;
+  pending->binaryCache = desc.binaryCache;
 
-  std::vector<std::tuple<ShaderType, std::string>> shaderContents;
+  if (!label.empty()) {
+    GLCALL(glObjectLabel(GL_PROGRAM, shaderId, (GLsizei)label.size(), label.data()));
+  }
+
+  // SPIR-V and glsl shaders can't be linked into one program, a program mixing them is built from the
+  // glsl fallbacks of its modules and rejected if one of them has none
+  const auto isSpirV = [](const ShaderInfo& si) { return std::holds_alternative<SpirV>(si.source); };
+  const bool allSpirV = std::ranges::all_of(shaders, isSpirV);
+  const bool fallbacks = std::ranges::all_of(shaders, [](const ShaderInfo& si) {
+    const auto* module = std::get_if<SpirV>(&si.source);
+    return !module || !std::holds_alternative<std::monostate>(module->fallback);
+  });
+  if (!allSpirV && !fallbacks && std::ranges::any_of(shaders, isSpirV)) {
+    err("Mixed SPIR-V and glsl program", "A program can't link SPIR-V modules with glsl stages, give every SPIR-V module a glsl fallback or use SPIR-V for every stage");
+    GLCALL(glDeleteProgram(shaderId));
+    shaderId = 0;
+    pending.reset();
+    return;
+  }
+  const bool useSpirV = allSpirV && GLAD_GL_ARB_gl_spirv;
+
+  const auto readStart = ShaderSourceCache::readTime();
+  const auto preprocessStart = Clock::now();
+  auto& shaderContents = pending->shaderContents;
   shaderContents.reserve(shaders.size());
   for (const auto& si : shaders) {
+    const auto* module = std::get_if<SpirV>(&si.source);
+    if (module && useSpirV) {
+      // The module, entry point and constants are the content, for the binary key
+      std::string content(reinterpret_cast<const char*>(module->code.data()), module->code.size() * sizeof(std::uint32_t));
+      content.append(module->entryPoint).push_back('\0');
+      content.append(reinterpret_cast<const char*>(module->constants.data()), module->constants.size() * sizeof(module->constants[0]));
+      shaderContents.push_back(std::make_tuple(si.type, std::move(content)));
+      pending->spirv.push_back(true);
+      continue;
+    }
     shaderContents.push_back(
-      std::make_tuple(si.type, std::visit(shaderReader, si.source))
+      std::make_tuple(si.type, read(si.source, err, &sourceFiles))
     );
+    pending->spirv.push_back(false);
+  }
+  timing.read = ShaderSourceCache::readTime() - readStart;
+  timing.preprocess = Clock::now() - preprocessStart - timing.read;
+
+  for (const auto& si : shaders) {
+    stages |= shaderTypeToStageBit.at((unsigned char)si.type);
+  }
+
+  if (desc.separable) {
+    GLCALL(glProgramParameteri(shaderId, GL_PROGRAM_SEPARABLE, GL_TRUE));
+  }
+
+  programKey = binaryKey(shaderContents, desc.separable);
+
+  const auto binaryStart = Clock::now();
+  timing.fromBinary = [&] {
+    if (desc.archive) {
+      GLenum binaryFormat = 0;
+      const auto stored = desc.archive->binary(programKey, binaryFormat);
+      if (!stored.empty() && loadBinary(binaryFormat, stored.data(), stored.size())) {
+        return true;
+      }
+    }
+    if (desc.binaryCache) {
+      const auto cached = desc.binaryCache->load(programKey);
+      if (cached && loadBinary(cached->format, cached->data.data(), cached->data.size())) {
+        return true;
+      }
+    }
+    return desc.binaryLocation && loadBinary(desc.binaryLocation.value(), programKey);
+  }();
+  timing.binaryLoad = Clock::now() - binaryStart;
+
+  if (timing.fromBinary) {
+    pending.reset();
+    reflect();
+    return;
+  }
+
+  if (desc.binaryLocation || desc.archive || desc.binaryCache) {
+    GLCALL(glProgramParameteri(shaderId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
   }
 
-  std::vector<unsigned int> shaderIds;
+  // Let the driver use as many compiler threads as it likes, only has an effect if nobody asks
+  // for a status right after submitting
+  static const bool parallelCompile = [] {
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+      GLCALL(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+    }
+    return true;
+  }();
+  (void)parallelCompile;
+
+  auto& shaderIds = pending->shaderIds;
   shaderIds.reserve(shaderContents.size());
-  for (const auto& [type, content] : shaderContents) {
-    shaderIds.push_back(
-      compile(content, shaderTypeToGlEnum.at((unsigned char)type), err)
-    );
+  const auto compileAll = [&] {
+    for (size_t i = 0; i < shaders.size(); ++i) {
+      const auto& [type, content] = shaderContents[i];
+      const GLenum glType = shaderTypeToGlEnum.at((unsigned char)type);
+      const auto compileStart = Clock::now();
+      shaderIds.push_back(
+        pending->spirv[i] ? compileSpirV(std::get<SpirV>(shaders[i].source), glType) : compile(content, glType)
+      );
+      timing.compile.at((unsigned char)type) += Clock::now() - compileStart;
+    }
+  };
+  compileAll();
+
+  // A module the driver rejects (or can't specialize) is retried from the glsl fallbacks, specializing
+  // happens right away so asking for the status doesn't wait for anything
+  if (useSpirV && fallbacks && std::ranges::any_of(shaderIds, [](GLuint id) {
+        int result;
+        GLCALL(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
+        return result != GL_TRUE;
+      })) {
+    for (const auto& id : shaderIds) {
+      GLCALL(glDeleteShader(id));
+    }
+    shaderIds.clear();
+    for (size_t i = 0; i < shaders.size(); ++i) {
+      std::get<1>(shaderContents[i]) = read(shaders[i].source, err, &sourceFiles);
+      pending->spirv[i] = false;
+    }
+    compileAll();
   }
 
   for(const auto& id : shaderIds) {
     GLCALL(glAttachShader(shaderId, id));
   }
 
+  const auto linkStart = Clock::now();
   GLCALL(glLinkProgram(shaderId));
+  timing.link = Clock::now() - linkStart;
+
+  if (!desc.deferred) {
+    finish();
+  }
+}
+
+void Shader::finish() const {
+  const auto p = std::move(pending);
+  const auto& err = p->err;
+
   int result;
+  const auto linkStart = Clock::now();
   GLCALL(glGetProgramiv(shaderId, GL_LINK_STATUS, &result));
+  timing.link += Clock::now() - linkStart;
   if (result != GL_TRUE) {
+    // A SPIR-V module is no text to show
+    const auto source = [&p](size_t i) {
+      return p->spirv[i] ? std::string("(SPIR-V module)") : std::get<1>(p->shaderContents[i]);
+    };
+    for (size_t i = 0; i < p->shaderIds.size(); ++i) {
+      compileStatus(p->shaderIds[i], std::get<0>(p->shaderContents[i]), source(i), err);
+    }
+
     int length = 0;
     GLCALL(glGetProgramiv(shaderId, GL_INFO_LOG_LENGTH, &length));
     char *message = new char[length];
     GLCALL(glGetProgramInfoLog(shaderId, length, &length, message));
     std::stringstream s;
     s << "Error: " <<  message << "\n";
-    for(const auto[type, content] : shaderContents){
-      s << shaderTypeToName.at((unsigned char) type) << " Shader:\n";
-      s << content;
+    for (size_t i = 0; i < p->shaderContents.size(); ++i) {
+      s << shaderTypeToName.at((unsigned char) std::get<0>(p->shaderContents[i])) << " Shader:\n";
+      s << source(i);
       s << "\n";
     }
     err("Shader Linking Error", s.str());
     delete[] message;
+    for(const auto& id : p->shaderIds) {
+      GLCALL(glDeleteShader(id));
+    }
     GLCALL(glDeleteProgram(shaderId));
+    shaderId = 0;
     return;
   }
 
-  if (binaryLocation) {
-    int numFormats = 0;
-    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
-    if(numFormats == 0) {
-      std::ofstream off(binaryLocation.value().parent_path() / "Zero binary formats suppoerted");
-    }
-    else {
-      GLint length = 0;
-      GLCALL(glGetProgramiv(shaderId, GL_PROGRAM_BINARY_LENGTH, &length));
-      std::vector<char> binary(length);
-
-      GLenum binaryFormat = 0;
-      GLCALL(glGetProgramBinary(shaderId, length, &length, &binaryFormat,
-                                binary.data()));
+  const auto retrievalStart = Clock::now();
+  if (p->binaryLocation) {
+    saveBinary(p->binaryLocation.value(), programKey);
+  }
 
-      std::ofstream off(binaryLocation.value(), std::ios::binary);
-      off.write(binary.data(), length);
-      std::ofstream format(binaryLocation.value().parent_path() / (binaryLocation.value().stem().string() + ".format"));
-      format << std::hex << binaryFormat << "\n";
+  if (p->binaryCache) {
+    if (const auto program = binary()) {
+      p->binaryCache->store(program.value());
     }
   }
+  timing.binaryRetrieval = Clock::now() - retrievalStart;
 
-  GLint numUniforms = 0;
-  glGetProgramiv(shaderId, GL_ACTIVE_UNIFORMS, &numUniforms);
-
-  for(int i = 0; i < numUniforms; ++i) {
-      char name[128];
-      GLsizei length;
-      GLint size;
-      GLenum type;
-      glGetActiveUniform(shaderId, i, sizeof(name), &length, &size, &type, name);
-      uniformInfo[name] = {glGetUniformLocation(shaderId, name), 0};
-  }
+  reflect();
 
 #ifndef NDEBUG
-  for(const auto& id : shaderIds) {
+  for(const auto& id : p->shaderIds) {
     GLCALL(glDetachShader(shaderId, id));
   }
 #endif
 
-  for(const auto& id : shaderIds) {
+  for(const auto& id : p->shaderIds) {
     GLCALL(glDeleteShader(id));
   }
 }
 
+bool Shader::isReady() const {
+  if (!pending) {
+    return true;
+  }
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    int done = GL_FALSE;
+    GLCALL(glGetProgramiv(shaderId, GL_COMPLETION_STATUS_KHR, &done));
+    if (done != GL_TRUE) {
+      return false;
+    }
+  }
+  finish();
+  return true;
+}
+
+void Shader::wait() const {
+  if (pending) {
+    finish();
+  }
+}
+
 Shader& Shader::operator=(Shader&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  release();
+  origin = other.origin;
   shaderId = std::exchange(other.shaderId, 0);
+  stages = other.stages;
+  programKey = other.programKey;
+  label = std::exchange(other.label, {});
+  timing = other.timing;
+  generation = other.generation;
+  blockBindings = std::exchange(other.blockBindings, {});
   uniformInfo = std::exchange(other.uniformInfo, {});
+  uniformNames = std::exchange(other.uniformNames, {});
+  uniformShadow = std::exchange(other.uniformShadow, {});
+  dirtySlots = std::exchange(other.dirtySlots, {});
+  reflected = std::exchange(other.reflected, {});
+  sourceFiles = std::exchange(other.sourceFiles, {});
+  pending = std::move(other.pending);
   return *this;
 }
 
-Shader::~Shader() {
+void Shader::replaceWith(Shader&& rebuilt) {
+  auto bindings = std::move(blockBindings);
+  *this = std::move(rebuilt);
+  for (const auto& [interface, name, binding] : bindings) {
+    if (interface == GL_UNIFORM_BLOCK) {
+      bindUniformBlock(name, binding);
+    } else {
+      bindStorageBlock(name, binding);
+    }
+  }
+}
+
+void Shader::release() {
+  if (pending) {
+    for(const auto& id : pending->shaderIds) {
+      GLCALL(glDeleteShader(id));
+    }
+    pending.reset();
+  }
   if(shaderId != 0) {
     GLCALL(glDeleteProgram(shaderId));
+    shaderId = 0;
   }
 }
 
-void Shader::bind() const { GLCALL(glUseProgram(shaderId)); }
+Shader::~Shader() {
+  release();
+}
+
+std::unique_ptr<Shader> Shader::rebuild(bool deferred) const {
+  Descriptor desc = origin->desc;
+  desc.deferred = deferred;
+  return std::make_unique<Shader>(origin->err, origin->shaders, desc);
+}
+
+void Shader::bind() const {
+  wait();
+  GLCALL(glUseProgram(shaderId));
+  flush();
+}
 
 void Shader::unbind() const {
 #ifndef NDEBUG
@@ -175,26 +773,175 @@ void Shader::unbind() const {
 #endif
 }
 
-const GLuint &Shader::GetId() const { return shaderId; }
+const GLuint &Shader::GetId() const {
+  wait();
+  return shaderId;
+}
+
+GLbitfield Shader::stageBits() const {
+  return stages;
+}
 
-GLint Shader::uniformLocation(const std::string& name) const {
-  auto it = uniformInfo.find(name);
-  if(it == uniformInfo.end()) {
+GLbitfield Shader::stageBit(ShaderType type) {
+  return shaderTypeToStageBit.at((unsigned char)type);
+}
+
+Shader::Timings::Duration Shader::Timings::total() const {
+  return std::accumulate(compile.begin(), compile.end(), read + preprocess + link + binaryLoad + binaryRetrieval + reflection);
+}
+
+const Shader::Timings& Shader::timings() const {
+  wait();
+  return timing;
+}
+
+// Quotes, backslashes and control characters escaped
+static std::string jsonString(std::string_view text) {
+  std::string out = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char escaped[7];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+      out.append(escaped);
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+  return out;
+}
+
+std::string Shader::timingsJson() const {
+  const auto& t = timings();
+  const auto micros = [](Timings::Duration duration) {
+    return std::to_string(std::chrono::duration<double, std::micro>(duration).count());
+  };
+  std::string out = "{\"label\": " + jsonString(label) + ", \"fromBinary\": " + (t.fromBinary ? "true" : "false");
+  out += ", \"readUs\": " + micros(t.read);
+  out += ", \"preprocessUs\": " + micros(t.preprocess);
+  out += ", \"compileUs\": {";
+  bool first = true;
+  for (size_t i = 0; i < t.compile.size(); ++i) {
+    if (stages & shaderTypeToStageBit[i]) {
+      out += (first ? "" : ", ") + jsonString(shaderTypeToName[i]) + ": " + micros(t.compile[i]);
+      first = false;
+    }
+  }
+  out += "}, \"linkUs\": " + micros(t.link);
+  out += ", \"binaryLoadUs\": " + micros(t.binaryLoad);
+  out += ", \"binaryRetrievalUs\": " + micros(t.binaryRetrieval);
+  out += ", \"reflectionUs\": " + micros(t.reflection);
+  out += ", \"totalUs\": " + micros(t.total()) + "}";
+  return out;
+}
+
+const std::vector<std::filesystem::path>& Shader::dependencies() const {
+  return sourceFiles;
+}
+
+bool Shader::dependsOn(const std::filesystem::path& file) const {
+  return std::ranges::find(sourceFiles, ShaderSourceCache::normalize(file)) != sourceFiles.end();
+}
+
+const Shader::Reflection& Shader::reflection() const {
+  wait();
+  return reflected;
+}
+
+GLint Shader::uniformLocation(std::string_view name) const {
+  const auto handle = uniformHandle(name);
+  if(!handle.valid()) {
     return -1;
   }
-  return it->second.location;
+  return uniformInfo[handle.index].location;
 }
 
-template <class T>
-static inline void hash_combine(std::size_t& seed, const T& v) {
-    std::hash<T> hasher;
-    seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+Shader::UniformHandle Shader::uniformHandle(std::string_view name) const {
+  return uniformHandle(fnv1a(name));
 }
 
-template<typename T>
-concept applyable = requires (const T tconst, GLint location) {
-  { tconst.apply(location) } -> std::same_as<void>;
-};
+Shader::UniformHandle Shader::uniformHandle(std::uint64_t nameHash) const {
+  wait();
+  if (uniformNames.empty()) {
+    return UniformHandle{};
+  }
+  const size_t mask = uniformNames.size() - 1;
+  for (size_t i = nameHash & mask;; i = (i + 1) & mask) {
+    const auto& entry = uniformNames[i];
+    if (entry.slot == UniformHandle::invalid) {
+      return UniformHandle{};
+    }
+    if (entry.hash == nameHash) {
+      return entry.slot == NameEntry::ambiguous ? UniformHandle{} : UniformHandle{entry.slot, generation};
+    }
+  }
+}
+
+void Shader::rememberBinding(GLenum interface, std::string_view name, GLuint binding) const {
+  auto it = std::ranges::find_if(blockBindings, [&](const BlockBinding& b) { return b.interface == interface && b.name == name; });
+  if (it != blockBindings.end()) {
+    it->binding = binding;
+  } else {
+    blockBindings.push_back({interface, std::string(name), binding});
+  }
+}
+
+bool Shader::bindUniformBlock(std::string_view name, GLuint binding) const {
+  wait();
+  auto it = std::ranges::find(reflected.uniformBlocks, name, &Reflection::Block::name);
+  if (it == reflected.uniformBlocks.end()) {
+    return false;
+  }
+  GLCALL(glUniformBlockBinding(shaderId, (GLuint)(it - reflected.uniformBlocks.begin()), binding));
+  it->binding = (GLint)binding;
+  rememberBinding(GL_UNIFORM_BLOCK, name, binding);
+  return true;
+}
+
+bool Shader::bindStorageBlock(std::string_view name, GLuint binding) const {
+  wait();
+  auto it = std::ranges::find(reflected.storageBlocks, name, &Reflection::Block::name);
+  if (it == reflected.storageBlocks.end()) {
+    return false;
+  }
+  GLCALL(glShaderStorageBlockBinding(shaderId, (GLuint)(it - reflected.storageBlocks.begin()), binding));
+  it->binding = (GLint)binding;
+  rememberBinding(GL_SHADER_STORAGE_BLOCK, name, binding);
+  return true;
+}
+
+void Shader::dispatch(GLuint groupsX, GLuint groupsY, GLuint groupsZ) const {
+  wait();
+  GLCALL(glDispatchCompute(groupsX, groupsY, groupsZ));
+}
+
+void Shader::dispatchIndirect(GLintptr offset) const {
+  wait();
+  GLCALL(glDispatchComputeIndirect(offset));
+}
+
+void Shader::dispatchIndirect(GLuint buffer, GLintptr offset) const {
+  GLCALL(glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer));
+  dispatchIndirect(offset);
+}
+
+std::array<GLint, 3> Shader::workGroupSize() const {
+  wait();
+  std::array<GLint, 3> size = {0, 0, 0};
+  GLCALL(glGetProgramiv(shaderId, GL_COMPUTE_WORK_GROUP_SIZE, size.data()));
+  return size;
+}
+
+void Shader::memoryBarrier(GLbitfield barriers) {
+  GLCALL(glMemoryBarrier(barriers));
+}
+
+void Shader::memoryBarrierByRegion(GLbitfield barriers) {
+  GLCALL(glMemoryBarrierByRegion(barriers));
+}
 
 template<typename T>
 concept vData = requires (T t) {
@@ -211,52 +958,93 @@ concept vMatrix = requires (T t) {
   {t.transpose} -> std::same_as<GLboolean&>;
 };
 
-void Shader::apply(const std::string& name, const UniformData& data) {
-	auto it = uniformInfo.find(name);
-	if (it == uniformInfo.end()) {
-		ERRORLOG("Uniform not active or not existent");
+void Shader::apply(std::string_view name, const UniformData& data) {
+	apply(uniformHandle(name), data);
+}
+
+void Shader::apply(UniformHandle handle, const UniformData& data) {
+  std::visit([this, handle](const auto& typed) { apply(handle, typed); }, data);
+}
+
+void Shader::stage(std::span<const UniformUpdate> updates) {
+  for (const auto& [handle, data] : updates) {
+    std::visit([this, handle](const auto& typed) { stage(handle, typed); }, data);
+  }
+}
+
+void Shader::flush() const {
+  for (const std::uint32_t slot : dirtySlots) {
+    auto& info = uniformInfo[slot];
+    if (!info.dirty) {
+      continue;
+    }
+    send(info);
+    info.dirty = false;
+  }
+  dirtySlots.clear();
+}
+
+void Shader::send(const UniformInfo& info) const {
+  info.setter(shaderId, info.location, info.count, info.transpose, uniformShadow.data() + info.offset);
+}
+
+void Shader::upload(UniformHandle handle, GLenum dataType, const void* data, size_t bytes, GLboolean transpose, bool deferred) {
+	wait();
+	if (!handle.valid() || handle.generation != generation || handle.index >= uniformInfo.size()) {
+		ERRORLOG("Uniform not active, not existent or the handle is from before the program was replaced");
 		return;
 	}
-	auto& info = it->second;
-
-  Visitor hasher{
-    []<typename T>(const T& t) requires (!vData<std::remove_cvref_t<decltype(t)>>){
-      constexpr std::size_t size = sizeof(T) / 4;
-      const auto& arr = std::bit_cast<std::array<std::uint32_t,size>>(t);
-      std::size_t s = 0;
-      for(const auto& elem : arr) {
-        hash_combine(s, elem);
-      }
-      return s;
-    },
-    [](const vData auto& t) {
-      using T_t = std::remove_cvref_t<decltype(t)>;
-      using Elem_t = std::remove_const_t<std::remove_pointer_t<decltype(t.value)>>;
-      std::size_t s = 0;
-      hash_combine(s, t.count);
-      if constexpr (vMatrix<T_t>){
-        hash_combine(s, t.transpose);
-      }
-      for (size_t i = 0; i < T_t::elements * t.count; ++i) {
-          hash_combine(s, std::hash<Elem_t>{}(t.value[i]));
-      }
-      return s;
-    },
-  };
+	auto& info = uniformInfo[handle.index];
 
-  const auto newHash = std::visit(hasher, data);
-
-  if(info.lastHash == newHash) return;
+#ifndef NDEBUG
+  if (!uniformAccepts(info.type, dataType)) {
+    ERRORLOG("Uniform data does not match the type the uniform is declared with");
+    return;
+  }
+#else
+  (void)dataType;
+#endif
+  if (!info.setter) {
+    ERRORLOG("Uniform type can't be set through apply");
+    return;
+  }
 
-  info.lastHash = newHash;
+  // Only as much as the uniform can hold ever reaches it, the rest is ignored by GL anyway
+  const size_t compared = std::min<size_t>(bytes, info.size);
+  if (compared == 0) {
+    return;
+  }
+  std::byte* shadow = uniformShadow.data() + info.offset;
 
-	Visitor applyer{
-	  [location = info.location](const applyable auto& a) {
-	    return a.apply(location);
-	  }
-	};
+  const size_t elementSize = info.size / (std::uint32_t)info.arraySize;
+  const auto count = (GLsizei)std::max<size_t>(compared / elementSize, 1);
 
-	std::visit(applyer, data);
+  // With staging the shadow is what GL has after the next flush, so this also skips restaging the same value
+  if (info.uploaded && info.transpose == transpose &&
+      std::memcmp(shadow, data, compared) == 0) {
+    // apply still has to send what an earlier stage left pending
+    if (deferred || !info.dirty) {
+      return;
+    }
+  }
+  else {
+    std::memcpy(shadow, data, compared);
+    info.uploaded = true;
+    info.transpose = transpose;
+    // A pending upload has to cover every element staged since the last one, not just the latest write
+    info.count = info.dirty ? std::max(info.count, count) : count;
+
+    if (deferred) {
+      if (!info.dirty) {
+        info.dirty = true;
+        dirtySlots.push_back(handle.index);
+      }
+      return;
+    }
+  }
+  // A staged value for the slot is superseded
+  info.dirty = false;
+  send(info);
 }
 
 void Shader::Data1f::apply(GLint location) const {
@@ -0,0 +1,239 @@
+#include "ShaderArchive.hpp"
+
+#include "Utilities.hpp"
+
+#include <cstring>
+
+ShaderArchive::ShaderArchive(const std::filesystem::path& location, Shader::ErrorHandler err)
+  : file(std::make_unique<MappedFile>(location)) {
+  if (!file->isValid()) {
+    err("Faild to open Shader Archive", "Faild to open : " + location.string());
+    return;
+  }
+  const std::string_view data = file->text();
+  const auto corrupt = [&](const std::string& what) {
+    err("Invalid Shader Archive", location.string() + ": " + what);
+    sources.clear();
+    programs.clear();
+    binaries.clear();
+    file.reset();
+  };
+  const auto inside = [&](std::uint64_t offset, std::uint64_t size) {
+    return offset <= data.size() && size <= data.size() - offset;
+  };
+  // The mapping has no alignment guarantees for the tables, copy entries out instead of casting
+  const auto entry = [&]<typename T>(size_t offset, T& out) {
+    std::memcpy(&out, data.data() + offset, sizeof(T));
+  };
+
+  Header header;
+  if (data.size() < sizeof(Header)) {
+    corrupt("too small");
+    return;
+  }
+  entry(0, header);
+  if (!std::equal(magic.begin(), magic.end(), header.magic) || header.version != version) {
+    corrupt("not an archive or a different version");
+    return;
+  }
+  const std::uint64_t tables = sizeof(Header) + (std::uint64_t)header.sources * sizeof(SourceEntry) +
+                               (std::uint64_t)header.programs * sizeof(ProgramEntry) + (std::uint64_t)header.binaries * sizeof(BinaryEntry);
+  if (!inside(0, tables)) {
+    corrupt("truncated index");
+    return;
+  }
+
+  size_t offset = sizeof(Header);
+  for (std::uint32_t i = 0; i < header.sources; ++i, offset += sizeof(SourceEntry)) {
+    SourceEntry source;
+    entry(offset, source);
+    if (!inside(source.offset, source.size)) {
+      corrupt("source out of bounds");
+      return;
+    }
+    sources.push_back(data.substr(source.offset, source.size));
+  }
+
+  for (std::uint32_t i = 0; i < header.programs; ++i, offset += sizeof(ProgramEntry)) {
+    ProgramEntry program;
+    entry(offset, program);
+    if (!inside(program.nameOffset, program.nameSize) || program.stageCount > 6) {
+      corrupt("program out of bounds");
+      return;
+    }
+    StoredProgram stored{program.separable != 0, {}};
+    for (std::uint32_t s = 0; s < program.stageCount; ++s) {
+      const auto [type, source] = program.stages[s];
+      if (type >= 6 || source >= sources.size()) {
+        corrupt("invalid stage");
+        return;
+      }
+      stored.stages.emplace_back(Shader::ShaderType(type), source);
+    }
+    programs.insert_or_assign(data.substr(program.nameOffset, program.nameSize), std::move(stored));
+  }
+
+  for (std::uint32_t i = 0; i < header.binaries; ++i, offset += sizeof(BinaryEntry)) {
+    BinaryEntry binary;
+    entry(offset, binary);
+    if (!inside(binary.offset, binary.size)) {
+      corrupt("binary out of bounds");
+      return;
+    }
+    binaries.push_back({binary.key, binary.fingerprint, binary.format,
+                        std::as_bytes(std::span(data.data() + binary.offset, binary.size))});
+  }
+}
+
+bool ShaderArchive::isOpen() const {
+  return file && file->isValid();
+}
+
+std::vector<std::string_view> ShaderArchive::names() const {
+  std::vector<std::string_view> result;
+  result.reserve(programs.size());
+  for (const auto& [name, program] : programs) {
+    result.push_back(name);
+  }
+  return result;
+}
+
+std::optional<ShaderArchive::Program> ShaderArchive::find(std::string_view name) const {
+  auto it = programs.find(name);
+  if (it == programs.end()) {
+    return std::nullopt;
+  }
+  Program result;
+  for (const auto& [type, source] : it->second.stages) {
+    result.shaders.push_back({type, sources[source]});
+  }
+  result.desc.separable = it->second.separable;
+  result.desc.archive = this;
+  return result;
+}
+
+std::span<const std::byte> ShaderArchive::binary(std::uint64_t key, GLenum& format) const {
+  auto it = std::ranges::find(binaries, key, &StoredBinary::key);
+  if (it == binaries.end()) {
+    return {};
+  }
+  format = it->format;
+  return it->data;
+}
+
+ShaderArchive::Writer::Writer(const ShaderArchive& archive) {
+  for (const auto source : archive.sources) {
+    addSource(std::string(source));
+  }
+  for (const auto& [name, program] : archive.programs) {
+    programs.push_back({std::string(name), program});
+  }
+  for (const auto& stored : archive.binaries) {
+    binaries.push_back({stored.fingerprint, {stored.format, stored.key, std::vector<std::byte>(stored.data.begin(), stored.data.end())}});
+  }
+}
+
+std::uint32_t ShaderArchive::Writer::addSource(std::string text) {
+  auto& candidates = sourceIndex[fnv1a(text)];
+  for (const std::uint32_t index : candidates) {
+    if (sources[index] == text) {
+      return index;
+    }
+  }
+  const auto index = (std::uint32_t)sources.size();
+  candidates.push_back(index);
+  sources.push_back(std::move(text));
+  return index;
+}
+
+void ShaderArchive::Writer::add(const std::string& name, const std::vector<Shader::ShaderInfo>& shaders, Shader::ErrorHandler err, bool separable) {
+  StoredProgram program{separable, {}};
+  for (const auto& shader : shaders) {
+    program.stages.emplace_back(shader.type, addSource(Shader::read(shader.source, err)));
+  }
+  auto it = std::ranges::find(programs, name, &ProgramData::name);
+  if (it != programs.end()) {
+    it->program = std::move(program);
+  } else {
+    programs.push_back({name, std::move(program)});
+  }
+}
+
+bool ShaderArchive::Writer::addBinary(const Shader& program) {
+  auto binary = program.binary();
+  if (!binary) {
+    return false;
+  }
+  auto it = std::ranges::find(binaries, binary->key, [](const BinaryData& data) { return data.binary.key; });
+  if (it != binaries.end()) {
+    it->binary = std::move(*binary);
+  } else {
+    binaries.push_back({Shader::driverFingerprint(), std::move(*binary)});
+  }
+  return true;
+}
+
+bool ShaderArchive::Writer::write(const std::filesystem::path& location, Shader::ErrorHandler err) const {
+  Header header{};
+  std::copy(magic.begin(), magic.end(), header.magic);
+  header.version = version;
+  header.sources = (std::uint32_t)sources.size();
+  header.programs = (std::uint32_t)programs.size();
+  header.binaries = (std::uint32_t)binaries.size();
+
+  std::uint64_t offset = sizeof(Header) + sources.size() * sizeof(SourceEntry) +
+                         programs.size() * sizeof(ProgramEntry) + binaries.size() * sizeof(BinaryEntry);
+  std::string index(reinterpret_cast<const char*>(&header), sizeof(Header));
+  const auto append = [&index](const auto& entry) {
+    index.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+  };
+
+  std::vector<std::string_view> blobs;
+  const auto place = [&](std::string_view blob) {
+    const std::uint64_t at = offset;
+    offset += blob.size();
+    blobs.push_back(blob);
+    return at;
+  };
+
+  for (const auto& source : sources) {
+    append(SourceEntry{place(source), source.size()});
+  }
+  for (const auto& [name, program] : programs) {
+    ProgramEntry entry{};
+    entry.nameOffset = place(name);
+    entry.nameSize = (std::uint32_t)name.size();
+    entry.separable = program.separable;
+    entry.stageCount = (std::uint32_t)std::min<size_t>(program.stages.size(), 6);
+    for (std::uint32_t s = 0; s < entry.stageCount; ++s) {
+      entry.stages[s][0] = (std::uint32_t)program.stages[s].first;
+      entry.stages[s][1] = program.stages[s].second;
+    }
+    append(entry);
+  }
+  for (const auto& [fingerprint, binary] : binaries) {
+    const std::string_view data(reinterpret_cast<const char*>(binary.data.data()), binary.data.size());
+    append(BinaryEntry{binary.key, fingerprint, place(data), data.size(), binary.format, 0});
+  }
+
+  auto temporary = location;
+  temporary += ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(index.data(), (std::streamsize)index.size());
+    for (const auto blob : blobs) {
+      out.write(blob.data(), (std::streamsize)blob.size());
+    }
+    if (!out) {
+      err("Faild to write Shader Archive", "Faild to write : " + temporary.string());
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(temporary, location, ec);
+  if (ec) {
+    err("Faild to write Shader Archive", "Faild to replace " + location.string() + ": " + ec.message());
+    return false;
+  }
+  return true;
+}
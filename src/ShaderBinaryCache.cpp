@@ -0,0 +1,194 @@
+#include "ShaderBinaryCache.hpp"
+
+#include "Utilities.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+static constexpr std::string_view binaryExtension = ".bin";
+static constexpr std::string_view temporaryExtension = ".tmp";
+
+// A writer that hasn't renamed its file after this long is assumed dead
+static constexpr auto abandonedAfter = std::chrono::hours(1);
+
+static std::uint64_t checksum(const std::vector<std::byte>& data) {
+  return fnv1a(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+ShaderBinaryCache::ShaderBinaryCache(std::filesystem::path directory, std::uintmax_t budget)
+  : directory(std::move(directory)), budget(budget) {
+  std::error_code ec;
+  std::filesystem::create_directories(this->directory, ec);
+  knownSize = size();
+}
+
+std::filesystem::path ShaderBinaryCache::location(std::uint64_t key) const {
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+  return directory / (std::string(name) + std::string(binaryExtension));
+}
+
+std::optional<Shader::Binary> ShaderBinaryCache::load(std::uint64_t key) const {
+  const auto file = location(key);
+
+  enum class Verdict { Missing, Valid, Foreign, Damaged };
+  const auto read = [&](Shader::Binary& binary) {
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream.is_open()) {
+      return Verdict::Missing;
+    }
+
+    Header header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      return Verdict::Damaged;
+    }
+    if (!std::equal(magic.begin(), magic.end(), header.magic) || header.version != version || header.key != key) {
+      return Verdict::Foreign;
+    }
+
+    // Size of the opened file, not of whatever is at the path by now. Checked before allocating,
+    // a damaged size could ask for anything
+    stream.seekg(0, std::ios::end);
+    const auto fileSize = (std::uintmax_t)stream.tellg();
+    stream.seekg(sizeof(header));
+    if (!stream || header.size != fileSize - sizeof(header)) {
+      return Verdict::Damaged;
+    }
+
+    binary = {header.format, key, std::vector<std::byte>(header.size)};
+    if (!stream.read(reinterpret_cast<char*>(binary.data.data()), (std::streamsize)header.size) ||
+        checksum(binary.data) != header.checksum) {
+      return Verdict::Damaged;
+    }
+    return Verdict::Valid;
+  };
+
+  Shader::Binary binary;
+  auto verdict = read(binary);
+  std::error_code ec;
+  if (verdict == Verdict::Damaged) {
+    // Published files are always complete, but another process may have renamed a fresh one into
+    // place since it was opened, only a file that is still damaged is deleted
+    verdict = read(binary);
+    if (verdict == Verdict::Damaged) {
+      std::filesystem::remove(file, ec);
+    }
+  }
+  if (verdict != Verdict::Valid) {
+    return std::nullopt;
+  }
+  // The modification time is what eviction goes by
+  std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+  return binary;
+}
+
+bool ShaderBinaryCache::store(const Shader::Binary& binary) {
+  Header header{};
+  std::copy(magic.begin(), magic.end(), header.magic);
+  header.version = version;
+  header.format = binary.format;
+  header.key = binary.key;
+  header.size = binary.data.size();
+  header.checksum = checksum(binary.data);
+
+  // Unique per writer, so processes storing the same key at once don't write into each others file
+  static thread_local std::mt19937_64 random{std::random_device{}()};
+  char suffix[17];
+  std::snprintf(suffix, sizeof(suffix), "%016llx", (unsigned long long)random());
+  auto temporary = location(binary.key);
+  temporary += ".";
+  temporary += suffix;
+  temporary += temporaryExtension;
+
+  {
+    std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(binary.data.data()), (std::streamsize)binary.data.size());
+    stream.flush();
+    if (!stream) {
+      stream.close();
+      std::error_code ec;
+      std::filesystem::remove(temporary, ec);
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(temporary, location(binary.key), ec);
+  if (ec) {
+    std::filesystem::remove(temporary, ec);
+    return false;
+  }
+  // Only scanning the directory when it may have outgrown the budget, not after every store
+  knownSize += sizeof(header) + binary.data.size();
+  if (knownSize > budget) {
+    evict();
+  }
+  return true;
+}
+
+void ShaderBinaryCache::evict() {
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type used;
+    std::uintmax_t size;
+  };
+  std::vector<Entry> entries;
+  std::uintmax_t total = 0;
+  const auto now = std::filesystem::file_time_type::clock::now();
+
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+    const auto& path = entry.path();
+    const auto used = entry.last_write_time(ec);
+    if (ec) {
+      continue;
+    }
+    if (path.extension() == temporaryExtension) {
+      if (now - used > abandonedAfter) {
+        std::filesystem::remove(path, ec);
+      }
+      continue;
+    }
+    if (path.extension() != binaryExtension) {
+      continue;
+    }
+    const auto size = entry.file_size(ec);
+    if (ec) {
+      continue;
+    }
+    entries.push_back({path, used, size});
+    total += size;
+  }
+
+  if (total <= budget) {
+    knownSize = total;
+    return;
+  }
+  std::ranges::sort(entries, {}, &Entry::used);
+  for (const auto& entry : entries) {
+    if (total <= budget) {
+      break;
+    }
+    // Another process may have evicted it already, the space is gone either way
+    std::filesystem::remove(entry.path, ec);
+    total -= entry.size;
+  }
+  knownSize = total;
+}
+
+std::uintmax_t ShaderBinaryCache::size() const {
+  std::uintmax_t total = 0;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+    if (entry.path().extension() == binaryExtension) {
+      total += entry.file_size(ec);
+    }
+  }
+  return total;
+}
+
+const std::filesystem::path& ShaderBinaryCache::GetDirectory() const {
+  return directory;
+}
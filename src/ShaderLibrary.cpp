@@ -0,0 +1,57 @@
+#include "ShaderLibrary.hpp"
+
+#include "ShaderSourceCache.hpp"
+
+ShaderLibrary::ShaderLibrary(Shader::ErrorHandler err)
+  :err(std::move(err)) {}
+
+void ShaderLibrary::buildAll(std::span<const ProgramDesc> descs, unsigned threads) {
+  std::vector<std::filesystem::path> files;
+  for (const auto& program : descs) {
+    for (const auto& shader : program.shaders) {
+      if (const auto* file = std::get_if<std::filesystem::path>(&shader.source)) {
+        files.push_back(*file);
+      }
+    }
+  }
+  ShaderSourceCache::global().preload(files, threads);
+
+  // Every source is in the cache now, constructing only concatenates them and submits the GL work
+  std::vector<std::unique_ptr<Shader>> built;
+  built.reserve(descs.size());
+  for (const auto& program : descs) {
+    Shader::Descriptor desc = program.desc;
+    desc.deferred = true;
+    if (desc.label.empty()) {
+      desc.label = program.name;
+    }
+    built.push_back(std::make_unique<Shader>(err, program.shaders, desc));
+  }
+
+  for (size_t i = 0; i < descs.size(); ++i) {
+    if (!descs[i].desc.deferred) {
+      built[i]->wait();
+    }
+    programs.insert_or_assign(descs[i].name, std::move(built[i]));
+  }
+}
+
+Shader* ShaderLibrary::get(std::string_view name) const {
+  auto it = programs.find(name);
+  if (it == programs.end()) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+size_t ShaderLibrary::size() const {
+  return programs.size();
+}
+
+std::string ShaderLibrary::timingsJson() const {
+  std::string out = "[";
+  for (const auto& [name, program] : programs) {
+    out += (out.size() > 1 ? ",\n " : "") + program->timingsJson();
+  }
+  return out + "]";
+}
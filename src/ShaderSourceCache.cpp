@@ -0,0 +1,157 @@
+#include "ShaderSourceCache.hpp"
+
+#include "MappedFile.hpp"
+
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+
+static thread_local std::chrono::nanoseconds threadReadTime{};
+
+std::chrono::nanoseconds ShaderSourceCache::readTime() {
+  return threadReadTime;
+}
+
+ShaderSourceCache& ShaderSourceCache::global() {
+  static ShaderSourceCache cache;
+  return cache;
+}
+
+std::filesystem::path ShaderSourceCache::normalize(const std::filesystem::path& file) {
+  return std::filesystem::absolute(file).lexically_normal();
+}
+
+std::shared_ptr<const ShaderSourceCache::File> ShaderSourceCache::load(const std::filesystem::path& file, Shader::ErrorHandler err) {
+  const auto path = normalize(file);
+  {
+    std::lock_guard lock(mutex);
+    if (auto it = files.find(path.string()); it != files.end()) {
+      return it->second;
+    }
+  }
+
+  // Read without holding the lock, two threads loading the same file both parse it and the first one is kept
+  const auto start = std::chrono::steady_clock::now();
+  const MappedFile content(path);
+  if (!content.isValid()) {
+    err("Faild to open File", "Faild to open : " + file.string());
+    return nullptr;
+  }
+
+  auto result = std::make_shared<File>();
+  std::string segment;
+  size_t lineNumber = 0;
+  const std::string_view text = content.text();
+  for (size_t position = 0; position < text.size();) {
+    const size_t end = std::min(text.find('\n', position), text.size());
+    const std::string_view line = text.substr(position, end - position);
+    position = end + 1;
+    ++lineNumber;
+    const size_t first = line.find_first_not_of(" \t");
+    if (first != std::string_view::npos && line.substr(first).starts_with("#include")) {
+      const size_t open = line.find_first_of("\"<", first + 8);
+      const size_t close = open == std::string_view::npos ? open : line.find_first_of("\">", open + 1);
+      if (close == std::string_view::npos) {
+        err("Invalid include", file.string() + ":" + std::to_string(lineNumber) + ": " + std::string(line));
+      } else {
+        result->segments.push_back(std::move(segment));
+        segment.clear();
+        result->includes.push_back((path.parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal());
+        result->includeLines.push_back(lineNumber);
+        continue;
+      }
+    }
+    segment.append(line).push_back('\n');
+  }
+  result->segments.push_back(std::move(segment));
+  threadReadTime += std::chrono::steady_clock::now() - start;
+
+  std::lock_guard lock(mutex);
+  return files.try_emplace(path.string(), std::move(result)).first->second;
+}
+
+void ShaderSourceCache::preload(std::span<const std::filesystem::path> list, unsigned threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const Shader::ErrorHandler ignore = [](std::string, std::string) {};
+
+  std::unordered_set<std::string> seen;
+  std::vector<std::filesystem::path> wave;
+  for (const auto& file : list) {
+    auto path = normalize(file);
+    if (seen.insert(path.string()).second) {
+      wave.push_back(std::move(path));
+    }
+  }
+
+  // The includes are only known once a file is parsed, so files are loaded in waves of include depth
+  while (!wave.empty()) {
+    std::vector<std::shared_ptr<const File>> loaded(wave.size());
+    std::atomic<size_t> next = 0;
+    {
+      std::vector<std::jthread> workers;
+      for (size_t i = 0; i < std::min<size_t>(threads, wave.size()); ++i) {
+        workers.emplace_back([&] {
+          for (size_t j = next++; j < wave.size(); j = next++) {
+            loaded[j] = load(wave[j], ignore);
+          }
+        });
+      }
+    }
+
+    std::vector<std::filesystem::path> includes;
+    for (const auto& file : loaded) {
+      if (!file) {
+        continue;
+      }
+      for (const auto& include : file->includes) {
+        if (seen.insert(include.string()).second) {
+          includes.push_back(include);
+        }
+      }
+    }
+    wave = std::move(includes);
+  }
+}
+
+void ShaderSourceCache::append(const std::filesystem::path& file, Shader::ErrorHandler err, std::vector<std::filesystem::path>& dependencies, std::string& out) {
+  if (std::ranges::find(dependencies, file) != dependencies.end()) {
+    return;
+  }
+  const size_t index = dependencies.size();
+  dependencies.push_back(file);
+
+  const auto content = load(file, err);
+  if (!content) {
+    return;
+  }
+
+  if (index != 0) {
+    out.append("#line 1 ").append(std::to_string(index)).push_back('\n');
+  }
+  for (size_t i = 0; i < content->includes.size(); ++i) {
+    out.append(content->segments[i]);
+    append(content->includes[i], err, dependencies, out);
+    out.append("#line ").append(std::to_string(content->includeLines[i] + 1))
+       .append(" ").append(std::to_string(index)).push_back('\n');
+  }
+  out.append(content->segments.back());
+}
+
+std::string ShaderSourceCache::resolve(const std::filesystem::path& file, Shader::ErrorHandler err, std::vector<std::filesystem::path>& dependencies) {
+  std::string out;
+  dependencies.clear();
+  append(normalize(file), err, dependencies, out);
+  return out;
+}
+
+void ShaderSourceCache::invalidate(const std::filesystem::path& file) {
+  std::lock_guard lock(mutex);
+  files.erase(normalize(file).string());
+}
+
+void ShaderSourceCache::clear() {
+  std::lock_guard lock(mutex);
+  files.clear();
+}
@@ -0,0 +1,105 @@
+#include "ShaderVariants.hpp"
+
+#include "Utilities.hpp"
+
+ShaderVariants::ShaderVariants(Shader::ErrorHandler err, std::vector<Shader::ShaderInfo> shaders, const Shader::Descriptor& desc)
+  : err(err), shaders(std::move(shaders)), desc(desc) {}
+
+void ShaderVariants::readSources() {
+  sourcesRead = true;
+  sources.reserve(shaders.size());
+  sourceHash = fnv1aOffsetBasis;
+  for (const auto& si : shaders) {
+    std::string content = Shader::read(si.source, err);
+    sourceHash = fnv1a(std::string_view(reinterpret_cast<const char*>(&si.type), sizeof(si.type)), sourceHash);
+    sourceHash = fnv1a(content, sourceHash);
+    sources.push_back({si.type, std::move(content)});
+  }
+}
+
+std::uint64_t ShaderVariants::key(const Defines& defines) {
+  if (!sourcesRead) {
+    readSources();
+  }
+  std::uint64_t key = sourceHash;
+  // std::map iterates sorted, so the same set always gives the same key
+  for (const auto& [name, value] : defines) {
+    key = fnv1a(name, key);
+    key = fnv1a("=", key);
+    key = fnv1a(value, key);
+    key = fnv1a("\n", key);
+  }
+  return key;
+}
+
+Shader& ShaderVariants::get(const Defines& defines) {
+  const std::uint64_t variantKey = key(defines);
+  auto it = variants.find(variantKey);
+  if (it != variants.end()) {
+    return *it->second;
+  }
+
+  std::vector<Shader::ShaderInfo> variantSources;
+  variantSources.reserve(sources.size());
+  for (const auto& [type, source] : sources) {
+    variantSources.push_back({type, injectDefines(std::get<std::string>(source), defines)});
+  }
+
+  Shader::Descriptor variantDesc = desc;
+  if (desc.binaryLocation) {
+    const auto& location = desc.binaryLocation.value();
+    std::stringstream name;
+    name << location.stem().string() << "_" << std::hex << variantKey << location.extension().string();
+    variantDesc.binaryLocation = location.parent_path() / name.str();
+  }
+
+  auto shader = std::make_unique<Shader>(err, variantSources, variantDesc);
+  return *variants.emplace(variantKey, std::move(shader)).first->second;
+}
+
+size_t ShaderVariants::size() const {
+  return variants.size();
+}
+
+std::string ShaderVariants::injectDefines(std::string_view source, const Defines& defines) {
+  if (defines.empty()) {
+    return std::string(source);
+  }
+
+  size_t insertAt = 0;
+  size_t nextLine = 1;
+  size_t lineStart = 0;
+  size_t line = 1;
+  while (lineStart < source.size()) {
+    size_t lineEnd = source.find('\n', lineStart);
+    if (lineEnd == std::string_view::npos) {
+      lineEnd = source.size();
+    }
+    const auto text = source.substr(lineStart, lineEnd - lineStart);
+    const size_t first = text.find_first_not_of(" \t");
+    if (first != std::string_view::npos && text.substr(first).starts_with("#version")) {
+      insertAt = std::min(lineEnd + 1, source.size());
+      nextLine = line + 1;
+      break;
+    }
+    lineStart = lineEnd + 1;
+    ++line;
+  }
+
+  std::string result;
+  result.reserve(source.size() + defines.size() * 32);
+  result.append(source.substr(0, insertAt));
+  if (insertAt != 0 && result.back() != '\n') {
+    result.push_back('\n');
+  }
+  for (const auto& [name, value] : defines) {
+    result.append("#define ").append(name);
+    if (!value.empty()) {
+      result.append(" ").append(value);
+    }
+    result.push_back('\n');
+  }
+  result.append("#line ").append(std::to_string(nextLine)).push_back('\n');
+  result.append(source.substr(insertAt));
+  return result;
+}
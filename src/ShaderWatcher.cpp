@@ -0,0 +1,110 @@
+#include "ShaderWatcher.hpp"
+
+#include "ShaderSourceCache.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+ShaderWatcher::ShaderWatcher() {
+#ifdef __linux__
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+  if (inotifyFd != -1) {
+    close(inotifyFd);
+  }
+#endif
+}
+
+void ShaderWatcher::watchFiles(const Shader& shader) {
+#ifdef __linux__
+  if (inotifyFd == -1) {
+    return;
+  }
+  for (const auto& file : shader.dependencies()) {
+    const auto directory = file.parent_path();
+    const int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd != -1) {
+      directories[wd] = directory;
+    }
+  }
+#else
+  (void)shader;
+#endif
+}
+
+void ShaderWatcher::watch(Shader& shader) {
+  if (std::ranges::find(shaders, &shader) != shaders.end()) {
+    return;
+  }
+  shaders.push_back(&shader);
+  watchFiles(shader);
+}
+
+void ShaderWatcher::unwatch(Shader& shader) {
+  std::erase(shaders, &shader);
+  std::erase_if(rebuilding, [&shader](const Rebuild& r) { return r.target == &shader; });
+}
+
+void ShaderWatcher::changed(const std::filesystem::path& file) {
+  ShaderSourceCache::global().invalidate(file);
+  for (Shader* shader : shaders) {
+    if (!shader->dependsOn(file)) {
+      continue;
+    }
+    // A newer change replaces a rebuild that is still running
+    auto it = std::ranges::find(rebuilding, shader, &Rebuild::target);
+    if (it != rebuilding.end()) {
+      it->shader = shader->rebuild();
+    } else {
+      rebuilding.push_back({shader, shader->rebuild()});
+    }
+  }
+}
+
+std::vector<Shader*> ShaderWatcher::poll() {
+#ifdef __linux__
+  if (inotifyFd != -1) {
+    alignas(inotify_event) char buffer[4096];
+    std::vector<std::filesystem::path> files;
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+      for (char* p = buffer; p < buffer + length;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(p);
+        p += sizeof(inotify_event) + event->len;
+        auto it = directories.find(event->wd);
+        if (it == directories.end() || event->len == 0) {
+          continue;
+        }
+        auto file = it->second / event->name;
+        if (std::ranges::find(files, file) == files.end()) {
+          files.push_back(std::move(file));
+        }
+      }
+    }
+    for (const auto& file : files) {
+      changed(file);
+    }
+  }
+#endif
+
+  std::vector<Shader*> replaced;
+  std::erase_if(rebuilding, [&replaced, this](Rebuild& r) {
+    if (!r.shader->isReady()) {
+      return false;
+    }
+    if (r.shader->GetId() != 0) {
+      r.target->replaceWith(std::move(*r.shader));
+      // New includes might have been added
+      watchFiles(*r.target);
+      replaced.push_back(r.target);
+    }
+    return true;
+  });
+  return replaced;
+}
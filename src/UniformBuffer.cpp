@@ -0,0 +1,46 @@
+#include "UniformBuffer.hpp"
+
+BlockBufferObject::BlockBufferObject(GLenum Target, GLuint Binding, GLsizeiptr Size, const void* Data)
+	:Target(Target), Binding(Binding), Size(Size) {
+	GLCALL(glCreateBuffers(1, &BufferId));
+	GLCALL(glNamedBufferStorage(BufferId, Size, Data, GL_DYNAMIC_STORAGE_BIT));
+	bind();
+}
+
+void BlockBufferObject::Upload(const void* Data, GLintptr Offset, GLsizeiptr Bytes) {
+	assert(Offset + Bytes <= Size);
+	GLCALL(glNamedBufferSubData(BufferId, Offset, Bytes, Data));
+}
+
+BlockBufferObject::BlockBufferObject(BlockBufferObject&& Other) noexcept
+	:BufferId(Other.BufferId), Target(Other.Target), Binding(Other.Binding), Size(Other.Size) {
+	Other.BufferId = 0;
+}
+
+BlockBufferObject& BlockBufferObject::operator=(BlockBufferObject&& Other) noexcept {
+	if (BufferId != 0) {
+		GLCALL(glDeleteBuffers(1, &BufferId));
+	}
+	BufferId = std::exchange(Other.BufferId, 0);
+	Target = Other.Target;
+	Binding = Other.Binding;
+	Size = Other.Size;
+	return *this;
+}
+
+BlockBufferObject::~BlockBufferObject() {
+	if (BufferId == 0) return;
+	GLCALL(glDeleteBuffers(1, &BufferId));
+}
+
+void BlockBufferObject::bind() const {
+	GLCALL(glBindBufferBase(Target, Binding, BufferId));
+}
+
+GLuint BlockBufferObject::GetId() const {
+	return BufferId;
+}
+
+GLuint BlockBufferObject::GetBinding() const {
+	return Binding;
+}
@@ -27,31 +27,157 @@ PixelBufferObject::~PixelBufferObject() {
 }
 	
 VertexArrayObject::VertexArrayObject(std::vector<VertexBufferObjectDescriptor> InitialBufferDescriptors) :BufferDescriptors(InitialBufferDescriptors) {
-	GLCALL(glGenVertexArrays(1, &VAO));
-	GLCALL(glBindVertexArray(VAO));
+	GLCALL(glCreateVertexArrays(1, &VAO));
 
 	GLuint AttributePosition = 0;
 
-	for (auto& BufferDescriptor : BufferDescriptors) {
-		GLCALL(glGenBuffers(1, &BufferDescriptor.VBO));
-		GLCALL(glBindBuffer(GL_ARRAY_BUFFER, BufferDescriptor.VBO));
-		GLCALL(glBufferData(GL_ARRAY_BUFFER, 0, 0, BufferDescriptor.Usage));
+	// Every buffer gets its own binding point, so a streaming buffer can move between regions by changing the offset of the binding
+	for (GLuint Binding = 0; Binding < BufferDescriptors.size(); ++Binding) {
+		auto& BufferDescriptor = BufferDescriptors[Binding];
+		if (BufferDescriptor.Regions != 0) {
+			AllocateStream(BufferDescriptor);
+		}
+		else {
+			GLCALL(glCreateBuffers(1, &BufferDescriptor.VBO));
+			GLCALL(glNamedBufferData(BufferDescriptor.VBO, GLsizeiptr(BufferDescriptor.Capacity) * BufferDescriptor.Stride, 0, BufferDescriptor.Usage));
+		}
+
+		GLCALL(glVertexArrayVertexBuffer(VAO, Binding, BufferDescriptor.VBO, 0, BufferDescriptor.Stride));
+		GLCALL(glVertexArrayBindingDivisor(VAO, Binding, BufferDescriptor.Instancingdivisor));
+		BufferDescriptor.PrepareVBO(VAO, AttributePosition, Binding);
+	}
+}
+
+bool VertexArrayObject::AllocateStream(VertexBufferObjectDescriptor& Descriptor) {
+	constexpr GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
-		BufferDescriptor.PrepareVBO(AttributePosition);
+	// Regions start on a 256 byte boundary, which also keeps them aligned for every attribute type
+	Descriptor.RegionBytes = (std::max<GLsizeiptr>(Descriptor.RegionBytes, Descriptor.Stride) + 255) / 256 * 256;
+	Descriptor.Region = 0;
+	Descriptor.Fences.assign(Descriptor.Regions, nullptr);
 
-		GLCALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	GLCALL(glCreateBuffers(1, &Descriptor.VBO));
+	GLCALL(glNamedBufferStorage(Descriptor.VBO, Descriptor.RegionBytes * Descriptor.Regions, nullptr, Flags));
+	Descriptor.Mapped = static_cast<std::byte*>(glMapNamedBufferRange(Descriptor.VBO, 0, Descriptor.RegionBytes * Descriptor.Regions, Flags));
+	if (Descriptor.Mapped) {
+		return true;
+	}
+
+	ERRORLOG("Mapping a streaming vertex buffer faild");
+	GLCALL(glDeleteBuffers(1, &Descriptor.VBO));
+	GLCALL(glCreateBuffers(1, &Descriptor.VBO));
+	GLCALL(glNamedBufferData(Descriptor.VBO, 0, 0, Descriptor.Usage));
+	Descriptor.Capacity = 0;
+	Descriptor.Fences.clear();
+	return false;
+}
+
+void VertexArrayObject::UploadStaged() {
+	for (size_t i = 0; i < BufferDescriptors.size(); ++i) {
+		auto& Descriptor = BufferDescriptors[i];
+		if (Descriptor.StagingPending) {
+			Descriptor.StagingPending = false;
+			UploadVertices(i, Descriptor.Staging.data(), Descriptor.NumVerts);
+		}
+	}
+}
+
+static void WaitAndDeleteFence(GLsync& Fence) {
+	if (!Fence) return;
+	GLenum Result;
+	do {
+		Result = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+	} while (Result == GL_TIMEOUT_EXPIRED);
+	GLCALL(glDeleteSync(Fence));
+	Fence = nullptr;
+}
+
+std::byte* VertexArrayObject::NextStreamRegion(size_t BufferIndex, GLsizeiptr Bytes) {
+	auto& Descriptor = BufferDescriptors[BufferIndex];
+
+	if (!Descriptor.Mapped) {
+		Descriptor.Staging.resize(Bytes);
+		Descriptor.StagingPending = true;
+		return Descriptor.Staging.data();
+	}
+
+	// Every draw reading the current region was issued already, fence them before moving on
+	if (!Descriptor.Fences[Descriptor.Region]) {
+		Descriptor.Fences[Descriptor.Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	if (Bytes > Descriptor.RegionBytes) {
+		// Deleting a buffer the GPU still reads from is fine, the driver keeps it alive until the draws are done
+		for (auto& Fence : Descriptor.Fences) {
+			if (Fence) {
+				GLCALL(glDeleteSync(Fence));
+			}
+		}
+		GLCALL(glDeleteBuffers(1, &Descriptor.VBO));
+		Descriptor.RegionBytes = std::max(Bytes, Descriptor.RegionBytes * 2);
+		if (!AllocateStream(Descriptor)) {
+			GLCALL(glVertexArrayVertexBuffer(VAO, (GLuint)BufferIndex, Descriptor.VBO, 0, Descriptor.Stride));
+			return NextStreamRegion(BufferIndex, Bytes);
+		}
+	}
+	else {
+		Descriptor.Region = (Descriptor.Region + 1) % Descriptor.Regions;
+		WaitAndDeleteFence(Descriptor.Fences[Descriptor.Region]);
+	}
+
+	const GLintptr Offset = Descriptor.RegionBytes * Descriptor.Region;
+	GLCALL(glVertexArrayVertexBuffer(VAO, (GLuint)BufferIndex, Descriptor.VBO, Offset, Descriptor.Stride));
+	return Descriptor.Mapped + Offset;
+}
+
+void VertexArrayObject::UploadVertices(size_t BufferIndex, const void* Data, GLsizei Count, const std::vector<std::pair<size_t, size_t>>* Ranges) {
+	auto& Descriptor = BufferDescriptors[BufferIndex];
+	Descriptor.NumVerts = Count;
+
+	GLsizei Capacity = Descriptor.Capacity;
+	if (Count > Capacity) {
+		Capacity = std::max(Count, Capacity * 2);
+	}
+	else if (Count < Capacity / 4) {
+		if (++Descriptor.SmallUpdates >= Descriptor.ShrinkAfter) {
+			Capacity = Count * 2;
+		}
+	}
+	else {
+		Descriptor.SmallUpdates = 0;
+	}
+
+	if (Capacity != Descriptor.Capacity) {
+		Descriptor.Capacity = Capacity;
+		Descriptor.SmallUpdates = 0;
+		GLCALL(glNamedBufferData(Descriptor.VBO, GLsizeiptr(Capacity) * Descriptor.Stride, nullptr, Descriptor.Usage));
+	}
+	else if (Ranges) {
+		const auto* Bytes = static_cast<const std::byte*>(Data);
+		for (const auto& [Begin, End] : *Ranges) {
+			GLCALL(glNamedBufferSubData(Descriptor.VBO, GLintptr(Begin) * Descriptor.Stride, GLsizeiptr(End - Begin) * Descriptor.Stride, Bytes + Begin * Descriptor.Stride));
+		}
+		return;
+	}
+	else {
+		// The old content is replaced anyway, this lets the driver hand out fresh memory instead of waiting for draws still reading it
+		GLCALL(glInvalidateBufferData(Descriptor.VBO));
+	}
+
+	if (Count != 0) {
+		GLCALL(glNamedBufferSubData(Descriptor.VBO, 0, GLsizeiptr(Count) * Descriptor.Stride, Data));
 	}
-	GLCALL(glBindVertexArray(0));
 }
 
 VertexArrayObject::VertexArrayObject(VertexArrayObject&& Other) noexcept
-	:VAO(std::move(Other.VAO)), BufferDescriptors(std::move(Other.BufferDescriptors))  {
+	:VAO(std::move(Other.VAO)), BufferDescriptors(std::move(Other.BufferDescriptors)), Elements(std::move(Other.Elements))  {
 	Other.VAO = 0;
 }
 
 VertexArrayObject& VertexArrayObject::operator=(VertexArrayObject&& Other) noexcept {
 	VAO = std::move(Other.VAO);
 	BufferDescriptors = std::move(Other.BufferDescriptors);
+	Elements = std::move(Other.Elements);
 	Other.VAO = 0;
 	return *this;
 }
@@ -59,6 +185,11 @@ VertexArrayObject& VertexArrayObject::operator=(VertexArrayObject&& Other) noexc
 VertexArrayObject::~VertexArrayObject() {
 	if (VAO == 0) return;
 	for (auto& BufferDescriptor : BufferDescriptors) {
+		for (auto& Fence : BufferDescriptor.Fences) {
+			if (Fence) {
+				GLCALL(glDeleteSync(Fence));
+			}
+		}
 		GLCALL(glDeleteBuffers(1, &BufferDescriptor.VBO));
 	}
 	GLCALL(glDeleteVertexArrays(1, &VAO));
@@ -72,7 +203,7 @@ void VertexArrayObject::unbind() {
 	GLCALL(glBindVertexArray(0));
 }
 
-void VertexArrayObject::DrawAs(GLenum mode) {
+GLsizei VertexArrayObject::InstanceCount() const {
 	bool HasInstanced = std::any_of(
 		BufferDescriptors.begin(),
 		BufferDescriptors.end(),
@@ -81,6 +212,20 @@ void VertexArrayObject::DrawAs(GLenum mode) {
 		}
 	);
 
+	if (!HasInstanced) {
+		return 0;
+	}
+	GLsizei instancecount = 1;
+	for (const auto& descriptor : BufferDescriptors) {
+		if (descriptor.Instancingdivisor != 0) {
+			instancecount = std::lcm(instancecount, descriptor.NumVerts);
+		}
+	}
+	return instancecount;
+}
+
+void VertexArrayObject::DrawAs(GLenum mode) {
+	UploadStaged();
 	GLsizei count = std::numeric_limits<GLsizei>::max();
 	for (const auto& descriptor : BufferDescriptors) {
 		if (descriptor.Instancingdivisor == 0 && descriptor.NumVerts < count) {
@@ -88,89 +233,117 @@ void VertexArrayObject::DrawAs(GLenum mode) {
 		}
 	}
 
-	if (!HasInstanced) {
+	const GLsizei instancecount = InstanceCount();
+	if (instancecount == 0) {
 		GLCALL(glDrawArrays(mode,GLint(0), count));
 		return;
 	}
-	GLsizei instancecount = 1;
-	for (const auto& descriptor : BufferDescriptors) {
-		if (descriptor.Instancingdivisor != 0) {
-			instancecount = std::lcm(instancecount, descriptor.NumVerts);
-		}
-	}
 
 	GLCALL(glDrawArraysInstanced(mode, GLint(0), count, instancecount));
 }
 
-void VertexBufferObjectDescriptor::PrepareVBO(GLuint& Position) {
-	PrepareVBOVertexFunktion(Position, Instancingdivisor);
+void VertexArrayObject::DrawElementsAs(GLenum mode) {
+	DrawElementsAs(mode, Elements.NumIndices, 0);
 }
 
-void TransformationVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(TransformationVertex), (void*)offsetof(TransformationVertex, Posx)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(TransformationVertex), (void*)offsetof(TransformationVertex, Sizex)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 1, GL_FLOAT, GL_FALSE, sizeof(TransformationVertex), (void*)offsetof(TransformationVertex, Rotation)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 1, GL_FLOAT, GL_FALSE, sizeof(TransformationVertex), (void*)offsetof(TransformationVertex, Scale)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+void VertexArrayObject::DrawElementsAs(GLenum mode, GLsizei Count, GLsizei FirstIndex, GLint BaseVertex) {
+	UploadStaged();
+	assert(Elements.EBO != 0 && FirstIndex + Count <= Elements.NumIndices);
+	const void* Offset = reinterpret_cast<const void*>(FirstIndex * Elements.IndexSize());
+
+	const GLsizei instancecount = InstanceCount();
+	if (instancecount == 0) {
+		if (BaseVertex == 0) {
+			GLCALL(glDrawElements(mode, Count, Elements.IndexType, Offset));
+		}
+		else {
+			GLCALL(glDrawElementsBaseVertex(mode, Count, Elements.IndexType, Offset, BaseVertex));
+		}
+		return;
+	}
+
+	if (BaseVertex == 0) {
+		GLCALL(glDrawElementsInstanced(mode, Count, Elements.IndexType, Offset, instancecount));
+	}
+	else {
+		GLCALL(glDrawElementsInstancedBaseVertex(mode, Count, Elements.IndexType, Offset, instancecount, BaseVertex));
+	}
 }
 
-void CoordVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(CoordVertex), (void*)offsetof(CoordVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+void VertexArrayObject::ReplaceIndexBuffer(std::span<const std::uint32_t> Indices, GLenum Usage) {
+	if (Elements.EBO == 0) {
+		Elements = IndexBufferObject(Usage);
+		GLCALL(glVertexArrayElementBuffer(VAO, Elements.EBO));
+	}
+	else if (Elements.Usage != Usage) {
+		//The hint only takes effect with a new data store
+		Elements.Usage = Usage;
+		Elements.CapacityBytes = 0;
+	}
+	Elements.Upload(Indices);
 }
 
-void TextureAndCoordVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(TextureAndCoordVertex), (void*)offsetof(TextureAndCoordVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(TextureAndCoordVertex), (void*)offsetof(TextureAndCoordVertex, u)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+const IndexBufferObject& VertexArrayObject::GetElements() const {
+	return Elements;
 }
 
+GLuint VertexArrayObject::GetId() const {
+	return VAO;
+}
+
+IndexBufferObject::IndexBufferObject(GLenum Usage) :Usage(Usage) {
+	GLCALL(glCreateBuffers(1, &EBO));
+}
 
-void CoordXYAndColourRGBVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(CoordXYAndColourRGBVertex), (void*)offsetof(CoordXYAndColourRGBVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 3, GL_FLOAT, GL_FALSE, sizeof(CoordXYAndColourRGBVertex), (void*)offsetof(CoordXYAndColourRGBVertex, r)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+IndexBufferObject::IndexBufferObject(IndexBufferObject&& Other) noexcept
+	:EBO(Other.EBO), Usage(Other.Usage), IndexType(Other.IndexType), NumIndices(Other.NumIndices), CapacityBytes(Other.CapacityBytes) {
+	Other.EBO = 0;
 }
 
+IndexBufferObject& IndexBufferObject::operator=(IndexBufferObject&& Other) noexcept {
+	std::swap(EBO, Other.EBO);
+	Usage = Other.Usage;
+	IndexType = Other.IndexType;
+	NumIndices = Other.NumIndices;
+	CapacityBytes = Other.CapacityBytes;
+	return *this;
+}
 
-void CoordXYAndColourRGBAVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(CoordXYAndColourRGBAVertex), (void*)offsetof(CoordXYAndColourRGBAVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 4, GL_FLOAT, GL_FALSE, sizeof(CoordXYAndColourRGBAVertex), (void*)offsetof(CoordXYAndColourRGBAVertex, r)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+IndexBufferObject::~IndexBufferObject() {
+	if (EBO == 0) return;
+	GLCALL(glDeleteBuffers(1, &EBO));
 }
 
-void CoordXYZAndColourRGBVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 3, GL_FLOAT, GL_FALSE, sizeof(CoordXYZAndColourRGBVertex), (void*)offsetof(CoordXYZAndColourRGBVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 3, GL_FLOAT, GL_FALSE, sizeof(CoordXYZAndColourRGBVertex), (void*)offsetof(CoordXYZAndColourRGBVertex, r)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+size_t IndexBufferObject::IndexSize() const {
+	return IndexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
 }
 
+void IndexBufferObject::Upload(std::span<const std::uint32_t> Indices) {
+	const std::uint32_t MaxIndex = Indices.empty() ? 0 : *std::max_element(Indices.begin(), Indices.end());
+	IndexType = MaxIndex <= std::numeric_limits<std::uint16_t>::max() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	NumIndices = (GLsizei)Indices.size();
+
+	std::vector<std::uint16_t> Short;
+	const void* Data = Indices.data();
+	if (IndexType == GL_UNSIGNED_SHORT) {
+		Short.assign(Indices.begin(), Indices.end());
+		Data = Short.data();
+	}
+
+	const GLsizeiptr Bytes = GLsizeiptr(Indices.size() * IndexSize());
+	if (Bytes > CapacityBytes) {
+		CapacityBytes = std::max(Bytes, CapacityBytes * 2);
+		GLCALL(glNamedBufferData(EBO, CapacityBytes, nullptr, Usage));
+	}
+	else {
+		GLCALL(glInvalidateBufferData(EBO));
+	}
+
+	if (Bytes != 0) {
+		GLCALL(glNamedBufferSubData(EBO, 0, Bytes, Data));
+	}
+}
 
-void CoordXYZAndColourRGBAVertex::PrepareVBO(GLuint& Position, GLuint Instancingdivisor) {
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 3, GL_FLOAT, GL_FALSE, sizeof(CoordXYZAndColourRGBAVertex), (void*)offsetof(CoordXYZAndColourRGBAVertex, x)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
-	GLCALL(glEnableVertexAttribArray(Position));
-	GLCALL(glVertexAttribPointer(Position, 4, GL_FLOAT, GL_FALSE, sizeof(CoordXYZAndColourRGBAVertex), (void*)offsetof(CoordXYZAndColourRGBAVertex, r)));
-	GLCALL(glVertexAttribDivisor(Position++, Instancingdivisor));
+void VertexBufferObjectDescriptor::PrepareVBO(GLuint VAO, GLuint& Position, GLuint Binding) {
+	PrepareVBOVertexFunktion(VAO, Position, Binding);
 }